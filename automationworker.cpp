@@ -2,6 +2,9 @@
 #include "StopToken.h"
 #include "scriptrunner.h"
 #include "taskmodel.h"
+#include "templatematcher.h"
+#include "scenerecognizer.h"
+#include "templatetuner.h"
 
 #include <QWebEngineView>
 #include <QCoreApplication>
@@ -17,9 +20,45 @@
 #include <opencv2/imgproc.hpp>
 #include <opencv2/imgcodecs.hpp>
 #include <QRegularExpression>
+#include <QDir>
+#include <QElapsedTimer>
 #include "imgdsl_qt.h"
+#include "imgdsl_co.h"
 #include <memory>
 
+// 任务图片名 -> 路径：含 '/' 的视为路径，否则取 游戏图片/<任务名>/<名称>.png
+static QString resolveTaskImage(const QString& taskName, const QString& imageNameOrPath)
+{
+    if (imageNameOrPath.contains('/')) {
+        return imageNameOrPath;
+    }
+    if (!taskName.isEmpty()) {
+        return QString("游戏图片/%1/%2.png").arg(taskName, imageNameOrPath);
+    }
+    qWarning() << "[AWToolbox] No task context set for simple image name:" << imageNameOrPath;
+    return imageNameOrPath;
+}
+
+// 逻辑坐标 -> 帧像素；空区域保持为空
+static cv::Rect toFrameRect(const QRect& region, qreal dpr)
+{
+    return cv::Rect(int(region.x() * dpr), int(region.y() * dpr),
+                    int(region.width() * dpr), int(region.height() * dpr));
+}
+static const int kFramePollMs = 40;         // 帧序列的截图间隔：截图本身还要几十毫秒
+static const double kRegionSameDiff = 3.0;  // 区域平均每字节差低于该值视为没有变化（与 clickEach 校验一致）
+
+// 任务开始前并行预加载任务目录下的全部模板（路径写法与 resolveImagePath 一致，才能命中缓存），返回日志
+static QString prefetchTaskTemplates(const QString& planName)
+{
+    const QString dir = QString("游戏图片/%1").arg(planName);
+    QStringList paths;
+    for (const QString& f : QDir(dir).entryList(QStringList() << "*.png", QDir::Files)) paths << dir + "/" + f;
+    QElapsedTimer timer;
+    timer.start();
+    vision::TemplateRegistry::instance().prefetch(paths);
+    return QString("预加载 %1 张模板，用时 %2 ms").arg(paths.size()).arg(timer.elapsed());
+}
 
 class AWToolbox : public imgdsl::IToolbox {
 public:
@@ -29,18 +68,93 @@ public:
                                   const QRect& /*roi*/, bool /*multiScale*/) override {
         imgdsl::MatchResult mr; mr.which = path;
         if (!w_) return mr;
-        QImage img = w_->capture();
-        if (img.isNull()) return mr;
+        auto frame = w_->captureFrame();
+        if (!frame) return mr;
         double sc = 0.0;
-        QPoint pt = w_->findTemplatePlaceholder(img, path, &sc, th);
+        QPoint pt = w_->findTemplatePlaceholder(*frame, path, &sc, th);
         if (pt.x() >= 0) { mr.matched = true; mr.point = pt; mr.score = sc; }
         return mr;
     }
 
+    // 组合条件的全部叶子共用一帧（帧统计量只算一次）
+    std::vector<imgdsl::MatchResult> findBatch(const std::vector<imgdsl::LeafQuery>& queries) override {
+        std::vector<imgdsl::MatchResult> out(queries.size());
+        for (size_t i = 0; i < queries.size(); ++i) out[i].which = queries[i].path;
+        if (!w_) return out;
+        auto frame = w_->captureFrame();
+        if (!frame) return out;
+        for (size_t i = 0; i < queries.size(); ++i) {
+            QElapsedTimer timer;
+            timer.start();
+            double sc = 0.0;
+            QPoint pt = w_->findTemplatePlaceholder(*frame, queries[i].path, &sc, queries[i].th);
+            if (pt.x() >= 0) { out[i].matched = true; out[i].point = pt; out[i].score = sc; }
+            out[i].costMs = timer.nsecsElapsed() / 1e6;
+        }
+        return out;
+    }
+
+    // 命中区域在后续帧中保持不变即视为稳定（只做区域帧差，不再重复匹配）
+    bool waitStable(const imgdsl::MatchResult& hit, int frames, int timeoutMs, bool* changed) override {
+        if (!w_) return false;
+        // NOT / 自定义条件没有命中模板，point 无意义：等整帧稳定
+        const QRect region = hit.path.isEmpty() ? QRect() : w_->templateRegion(hit.point, hit.path);
+        return w_->waitRegionStable(region, frames, timeoutMs, changed);
+    }
+
+    imgdsl::MatchResult findFamily(const QStringList& paths, double th,
+                                   const QRect& roi) override {
+        imgdsl::MatchResult mr;
+        if (!w_) return mr;
+        auto frame = w_->captureFrame();
+        if (!frame) return mr;
+        double sc = 0.0;
+        QString variant;
+        QPoint pt = w_->findFamilyPlaceholder(*frame, paths, &sc, th, &variant, roi);
+        if (pt.x() >= 0) { mr.matched = true; mr.point = pt; mr.score = sc; mr.which = variant; }
+        return mr;
+    }
+
+    std::vector<imgdsl::MatchResult> findAll(const QStringList& paths, double th, const QRect& roi,
+                                             int maxCount, imgdsl::SortBy sortBy) override {
+        std::vector<imgdsl::MatchResult> out;
+        if (!w_) return out;
+        auto frame = w_->captureFrame();
+        if (!frame) return out;
+        QList<double> scores;
+        QStringList which;
+        const QList<QPoint> pts = w_->findAllTemplatePlaceholders(
+            *frame, paths, th, maxCount, sortBy == imgdsl::SortBy::Score, &scores, &which, roi);
+        for (int i = 0; i < pts.size(); ++i) {
+            imgdsl::MatchResult mr;
+            mr.matched = true;
+            mr.point = pts[i];
+            mr.score = scores.value(i);
+            mr.which = which.value(i);
+            out.push_back(mr);
+        }
+        return out;
+    }
+
+    int clickEach(const QStringList& paths, double th, const QRect& roi,
+                  int delayMs, bool verify) override {
+        if (!w_) return 0;
+        QStringList clicked;
+        int unverified = 0;
+        const int n = w_->clickEach(paths, th, delayMs, verify, QPoint(), &clicked, roi, &unverified);
+        if (n > 0) emit w_->logThumb(QStringLiteral("点击"), clicked, th, -1, 1.0);
+        if (unverified > 0) emit w_->log(QStringLiteral("[EACH] %1 次点击后画面无变化，未计入").arg(unverified));
+        return n;
+    }
+
     bool clickLogical(const QPoint& logicalPt) override {
         return w_ ? w_->clickAt(logicalPt) : false;
     }
 
+    bool clickAndSettle(const QPoint& logicalPt, int maxWaitMs) override {
+        return w_ ? w_->clickAndSettle(logicalPt, maxWaitMs) : false;
+    }
+
     void sleepMs(int ms) override { w_ ? w_->sleepMs(ms) : QThread::msleep(static_cast<unsigned long>(ms)); }
 
     void logAction(const QString& action, const QString& conditionName, int timeout, const imgdsl::MatchResult* result) override {
@@ -93,24 +207,125 @@ public:
         currentTaskName_.clear();
     }
     QString resolveImagePath(const QString& imageNameOrPath) const override {
+        return resolveTaskImage(currentTaskName_, imageNameOrPath);
+    }
+    imgdsl::ConditionStatsRegistry* conditionStats() override {
+        return w_ ? w_->conditionStats() : nullptr;
+    }
 
-        if (imageNameOrPath.contains('/')) {
-            return imageNameOrPath;
-        }
-        if (!currentTaskName_.isEmpty()) {
-            QString fullPath = QString("游戏图片/%1/%2.png").arg(currentTaskName_, imageNameOrPath);
-            return fullPath;
+private:
+    AutomationWorker* w_{};
+    QString currentTaskName_; // 【修正】添加成员变量
+};
+
+#ifdef IMGDSL_HAS_COROUTINES
+// 协程版工具接口：截图、点击投递到 GUI 线程不等待，匹配在调度线程上进行。
+// 匹配备忘、增量匹配器和设备像素比都归本任务所有，不碰工作线程版的状态，也不在调度线程上访问 view
+class AWAsyncToolbox : public imgdsl::co::IAsyncToolbox {
+public:
+    AWAsyncToolbox(AutomationWorker* w, const QString& taskName) : w_(w), taskName_(taskName) {
+        context_.toolbox = this;
+    }
+
+    imgdsl::co::TaskContext* context() { return &context_; }
+
+    void requestFrame(std::function<void(bool)> done) override {
+        w_->captureAsync([this, done](QImage img, qreal dpr) {
+            // GUI 线程只负责截图，转成帧（颜色转换等）留到调度线程上匹配时再做
+            image_ = std::move(img);
+            dpr_ = dpr;
+            frame_.reset();
+            done(!image_.isNull());
+        });
+    }
+
+    std::vector<imgdsl::MatchResult> matchBatch(const std::vector<imgdsl::LeafQuery>& queries) override {
+        std::vector<imgdsl::MatchResult> out(queries.size());
+        for (size_t i = 0; i < queries.size(); ++i) out[i].which = queries[i].path;
+        if (!currentFrame()) return out;
+        for (size_t i = 0; i < queries.size(); ++i) {
+            QElapsedTimer timer;
+            timer.start();
+            const vision::Hit hit = w_->findTemplateHit(*frame_, queries[i].path, queries[i].th, memo_, incremental_);
+            if (hit.found) {
+                const cv::Point c = hit.center();
+                out[i].matched = true;
+                out[i].point = QPoint(int(c.x / dpr_), int(c.y / dpr_));
+                out[i].score = hit.score;
+            }
+            out[i].costMs = timer.nsecsElapsed() / 1e6;
         }
-        qWarning() << "[AWToolbox] No task context set for simple image name:" << imageNameOrPath;
-        return imageNameOrPath;
+        return out;
+    }
+
+    void requestClick(const QPoint& logicalPt, std::function<void(bool)> done) override {
+        w_->clickAtAsync(logicalPt, std::move(done));
+    }
+
+    void markFrame() override { baseline_ = currentFrame(); }
+
+    bool regionChanged(const QPoint& center, int radius) override {
+        if (!baseline_ || !currentFrame()) return false;
+        const QRect region(center.x() - radius, center.y() - radius, 2 * radius, 2 * radius);
+        return vision::regionDifference(*baseline_, *frame_, toFrameRect(region, dpr_)) >= kRegionSameDiff;
+    }
+
+    void recordSettle(int waitedMs, bool settled, int maxWaitMs) override {
+        ++settle_.clicks;
+        if (settled) ++settle_.settled;
+        settle_.waitedMs += quint64(waitedMs);
+        settle_.budgetMs += quint64(maxWaitMs);
     }
 
+    quint64 savedMatchCount() const { return memo_.saved(); }
+    AutomationWorker::SettleStats settleStats() const { return settle_; }
+
+    bool cancelled() const override { return w_->shouldStop("co"); }
+
+    void logAction(const QString& action, const QString& conditionName, int timeout,
+                   const imgdsl::MatchResult* result) override {
+        QString msg = QString("[%1] %2").arg(action, conditionName);
+        if (result && result->matched) msg.append(" -> " + QFileInfo(result->which).fileName());
+        if (timeout > 0) msg.append(QStringLiteral(" (超时=%1ms)").arg(timeout));
+        emit w_->log(msg);
+    }
+    void logInfo(const QString& message) override { emit w_->log(QString("[信息] %1").arg(message)); }
+    void logError(const QString& message) override { emit w_->log(QString("[错误] %1").arg(message)); }
+    void logSuccess(const QString& message) override { emit w_->log(QString("[成功] %1").arg(message)); }
+
+    QString resolveImagePath(const QString& imageNameOrPath) const override {
+        return resolveTaskImage(taskName_, imageNameOrPath);
+    }
+    imgdsl::ConditionStatsRegistry* conditionStats() override { return w_->conditionStats(); }
+
 private:
+    // 最近一次截图对应的帧，首次使用时转换
+    const std::shared_ptr<vision::Frame>& currentFrame() {
+        if (!frame_ && !image_.isNull()) frame_ = vision::Frame::fromImage(image_);
+        return frame_;
+    }
+
     AutomationWorker* w_{};
-    QString currentTaskName_; // 【修正】添加成员变量
+    QString taskName_;
+    imgdsl::co::TaskContext context_;
+    QImage image_;                              // 最近一次截图
+    qreal dpr_ = 1.0;                           // 截图时在 GUI 线程上读取的设备像素比
+    std::shared_ptr<vision::Frame> frame_;      // image_ 对应的帧
+    std::shared_ptr<vision::Frame> baseline_;   // markFrame 记下的比较基准
+    vision::MatchMemo memo_;
+    vision::IncrementalMatcher incremental_;
+    AutomationWorker::SettleStats settle_;
 };
+#else
+class AWAsyncToolbox {};    // 未以 C++20 编译时没有协程版任务
+#endif
 AutomationWorker::~AutomationWorker()
 {
+#ifdef IMGDSL_HAS_COROUTINES
+    // 协程版任务还没结束：先从调度器上取消（销毁挂起的协程帧），再释放它用的工具接口
+    if (coToolbox_) imgdsl::co::Scheduler::instance().cancel(coToolbox_->context());
+#endif
+    vision::SceneRecognizer::instance().forgetTitles(this);
     if (imgdsl::toolbox() == toolbox_.get()) {
         // ...那么在我被销毁之前，必须将全局指针清空
         imgdsl::set_toolbox(nullptr);
@@ -125,18 +340,9 @@ AutomationWorker::AutomationWorker(QWebEngineView* view,
     : QObject(parent), view_(view), stop_(std::move(stop))
 {
     toolbox_ = std::make_unique<AWToolbox>(this);
-}
-// ====== 2) 读图工具：支持资源路径和中文文件路径 ======
-static cv::Mat imreadSafe(const QString& filePath, int flags = cv::IMREAD_COLOR) {
-    QFile file(filePath);
-    if (!file.open(QIODevice::ReadOnly)) {
-        qWarning() << "[imreadWithChinesePath] Cannot open file:" << filePath;
-        return {};
-    }
-    QByteArray data = file.readAll();
-    file.close();
-    std::vector<uchar> buf(data.begin(), data.end());
-    return cv::imdecode(buf, flags);
+    memo_ = std::make_unique<vision::MatchMemo>();
+    incremental_ = std::make_unique<vision::IncrementalMatcher>();
+    conditionStats_ = std::make_unique<imgdsl::ConditionStatsRegistry>();
 }
 // ====== 3) 截图：优先 QWidget::grab()（逻辑像素），不可见时回退 QScreen::grabWindow()（设备像素） ======
 QImage AutomationWorker::capture() {
@@ -148,6 +354,22 @@ QImage AutomationWorker::capture() {
     }, Qt::BlockingQueuedConnection);
     return img;
 }
+void AutomationWorker::captureAsync(std::function<void(QImage, qreal)> done) {
+    QPointer<QWebEngineView> v = view_;
+    if (!v) { done(QImage(), 1.0); return; }
+    QMetaObject::invokeMethod(v, [v, done]() {
+        if (!v) { done(QImage(), 1.0); return; }
+        done(v->grab().toImage(), v->devicePixelRatioF());
+    }, Qt::QueuedConnection);
+}
+std::shared_ptr<vision::Frame> AutomationWorker::captureFrame() {
+    auto frame = vision::Frame::fromImage(capture());
+    if (frame) {
+        vision::TemplateTuner::instance().addSample(*frame);   // 供模板策略自动调优做样本（内部限频）
+        lastFrame_ = frame;
+    }
+    return frame;
+}
 // ====== 4) 模板匹配：返回 view 的“局部逻辑坐标” ======
 QPoint AutomationWorker::findTemplatePlaceholder(const QImage& screen,
                                                  const QString& tplPath,
@@ -155,44 +377,356 @@ QPoint AutomationWorker::findTemplatePlaceholder(const QImage& screen,
                                                  double threshold)
 {
     if (outScore) *outScore = 0.0;
-    if (screen.isNull()) return QPoint(-1, -1);
-
-    // QImage -> cv::Mat (BGRA → BGR)
-    cv::Mat srcRGBA(screen.height(), screen.width(), CV_8UC4,
-                    const_cast<uchar*>(screen.bits()), screen.bytesPerLine());
-    cv::Mat srcBGR;
-    cv::cvtColor(srcRGBA, srcBGR, cv::COLOR_BGRA2BGR);
-
-    // 模板
-    cv::Mat tpl = imreadSafe(tplPath, cv::IMREAD_COLOR);
-    if (tpl.empty()) {
-        qWarning() << "[findTemplatePlaceholder] template empty:" << tplPath;
+    auto frame = vision::Frame::fromImage(screen);
+    if (!frame) return QPoint(-1, -1);
+    return findTemplatePlaceholder(*frame, tplPath, outScore, threshold);
+}
+QPoint AutomationWorker::findTemplatePlaceholder(const vision::Frame& frame,
+                                                 const QString& tplPath,
+                                                 double* outScore,
+                                                 double threshold)
+{
+    if (outScore) *outScore = 0.0;
+    const vision::Hit hit = findTemplateHit(frame, tplPath, threshold, *memo_, *incremental_);
+    if (outScore) *outScore = hit.score;
+    if (!hit.found) return QPoint(-1, -1);
+
+    // 命中中心（当前坐标系与 screen 一致）
+    const cv::Point c = hit.center();
+
+    const qreal dpr = view_->devicePixelRatioF(); // 例如 1.0、1.25、1.5、2.0 等
+    QPoint localLogical( int(c.x / dpr), int(c.y / dpr) );
+    return localLogical;
+}
+vision::Hit AutomationWorker::findTemplateHit(const vision::Frame& frame, const QString& tplPath, double threshold,
+                                             vision::MatchMemo& memo, vision::IncrementalMatcher& incremental)
+{
+    vision::Hit hit;
+    if (frame.empty()) return hit;
+
+    // 模板（注册表内已预计算零均值像素与范数）
+    auto tpl = vision::TemplateRegistry::instance().get(tplPath);
+    if (!tpl) {
+        qWarning() << "[findTemplateHit] template empty:" << tplPath;
+        return hit;
+    }
+
+    // 画面与之前某次完全相同（静止界面上的重复轮询）时直接复用当时的结果；
+    // 以内容寻址的键记忆，不同目录中的同一张图共用
+    const QString memoKey = QString("%1|%2").arg(tpl->blobKey).arg(vision::effectiveThreshold(*tpl, threshold));
+    const quint64 frameHash = frame.contentHash();
+    if (!memo.lookup(frameHash, memoKey, &hit)) {
+        bool complete = true;
+        hit = matchTemplateHit(frame, tplPath, tpl, threshold, incremental, &complete);
+        // 预算截断的结果只覆盖部分画面；记下来会让静止画面上的后续轮询永远看不到没扫到的位置
+        if (complete) memo.store(frameHash, memoKey, hit);
+    }
+    return hit;
+}
+vision::Hit AutomationWorker::matchTemplateHit(const vision::Frame& frame, const QString& tplPath,
+                                              const std::shared_ptr<const vision::CompiledTemplate>& tpl,
+                                              double threshold, vision::IncrementalMatcher& incremental,
+                                              bool* complete)
+{
+    if (complete) *complete = true;
+    // 标题模板（xxx标题）先问场景识别器：确定处于其他界面则不必匹配；
+    // 确定处于该界面时只在本窗口上次命中的位置附近复核，复核不过再整帧匹配
+    const QString scene = vision::SceneRecognizer::sceneForTemplate(tplPath);
+    auto& recognizer = vision::SceneRecognizer::instance();
+    const cv::Size frameSize(frame.width(), frame.height());
+    vision::Hit hit;
+    if (!scene.isEmpty()) {
+        const auto r = recognizer.recognize(frame);
+        if (r.confident && r.scene != scene && recognizer.hasScene(scene)) {
+            return hit;
+        }
+        vision::Hit cached;
+        if (r.confident && r.scene == scene && recognizer.cachedTitle(this, frameSize, tplPath, &cached)) {
+            static const int kTitleVerifyMargin = 4;
+            const cv::Rect around(cached.topLeft.x - kTitleVerifyMargin, cached.topLeft.y - kTitleVerifyMargin,
+                                  cached.size.width + 2 * kTitleVerifyMargin,
+                                  cached.size.height + 2 * kTitleVerifyMargin);
+            hit = vision::match(frame, *tpl, threshold, around & cv::Rect(cv::Point(), frameSize));
+            if (hit.found) return hit;
+            hit = vision::Hit();
+        }
+    }
+
+    // 匹配（按模板元数据选择策略；帧侧统计量在同一帧的所有模板间共享；
+    // NCC 全帧匹配只重算相对上次发生变化的区域，整帧重扫受时间预算约束，分块之间响应停止）
+    vision::MatchBudget budget;
+    if (matchBudgetMs_ > 0) budget.deadline = QDeadlineTimer(matchBudgetMs_);
+    budget.cancelled = [this]() { return shouldStop("match"); };
+    bool done = true;
+    hit = incremental.match(frame, tpl, threshold, &budget, &done);
+    if (complete) *complete = done;
+    if (done && !scene.isEmpty() && hit.found) {
+        // 只用高分的整帧匹配学习参考帧，避免误命中把错误的帧加进参考、再让识别结论自我强化
+        static const double kLearnScore = 0.95;
+        if (hit.score >= kLearnScore) recognizer.addReference(scene, frame.sceneHash());
+        recognizer.rememberTitle(this, frameSize, tplPath, hit);
+    }
+    return hit;
+}
+quint64 AutomationWorker::savedMatchCount() const
+{
+    return memo_ ? memo_->saved() : 0;
+}
+void AutomationWorker::logSavedMatches(quint64 saved, quint64 total)
+{
+    if (saved > 0) {
+        emit log(QStringLiteral("[缓存] 画面未变化，复用匹配结果 %1 次（累计 %2 次）")
+                     .arg(saved).arg(total));
+    }
+}
+QPoint AutomationWorker::findFamilyPlaceholder(const vision::Frame& frame,
+                                               const QStringList& variantPngs,
+                                               double* outScore,
+                                               double threshold,
+                                               QString* outVariant,
+                                               const QRect& roi)
+{
+    if (outScore) *outScore = 0.0;
+    if (outVariant) outVariant->clear();
+    if (frame.empty()) return QPoint(-1, -1);
+
+    auto family = vision::TemplateRegistry::instance().family(variantPngs);
+    if (!family) {
+        qWarning() << "[findFamilyPlaceholder] family empty:" << variantPngs;
         return QPoint(-1, -1);
     }
 
-    // 尺寸检查
-    int rw = srcBGR.cols - tpl.cols + 1;
-    int rh = srcBGR.rows - tpl.rows + 1;
-    if (rw <= 0 || rh <= 0) return QPoint(-1, -1);
+    const qreal dpr = view_->devicePixelRatioF();
+    vision::FamilyHit fh = vision::matchFamily(frame, *family, threshold, toFrameRect(roi, dpr));
+    if (outScore) *outScore = fh.hit.score;
+    if (!fh.hit.found) return QPoint(-1, -1);
+    if (outVariant) *outVariant = fh.variantPath;
 
-    // 匹配
-    cv::Mat result(rh, rw, CV_32FC1);
-    cv::matchTemplate(srcBGR, tpl, result, cv::TM_CCOEFF_NORMED);
+    const cv::Point c = fh.hit.center();
+    return QPoint(int(c.x / dpr), int(c.y / dpr));
+}
+QList<QPoint> AutomationWorker::findAllTemplatePlaceholders(const vision::Frame& frame,
+                                                            const QStringList& templatePngs,
+                                                            double threshold,
+                                                            int maxCount,
+                                                            bool sortByScore,
+                                                            QList<double>* outScores,
+                                                            QStringList* outPaths,
+                                                            const QRect& roi)
+{
+    QList<QPoint> points;
+    if (outScores) outScores->clear();
+    if (outPaths) outPaths->clear();
+    if (frame.empty()) return points;
+
+    const vision::HitOrder order = sortByScore ? vision::HitOrder::Score : vision::HitOrder::Position;
+    const qreal dpr = view_->devicePixelRatioF();
+    const cv::Rect callerRoi = toFrameRect(roi, dpr);
+    const cv::Rect frameRect(0, 0, frame.width(), frame.height());
+    // roi 完全在画面外：没有可找的区域，不能退回全帧搜索
+    if (!roi.isEmpty() && (callerRoi & frameRect).area() <= 0) return points;
+
+    // 每个模板各取一张结果图，合并后再做一次跨模板的抑制
+    std::vector<vision::Hit> hits;
+    for (int i = 0; i < templatePngs.size(); ++i) {
+        auto tpl = vision::TemplateRegistry::instance().get(templatePngs[i]);
+        if (!tpl) {
+            qWarning() << "[findAllTemplatePlaceholders] template empty:" << templatePngs[i];
+            continue;
+        }
+        // 与单模板匹配一致：只在 roi（调用方或模板清单给定）内搜索
+        const cv::Rect search = vision::searchArea(*tpl, callerRoi);
+        if (search.area() > 0 && (search & frameRect).area() <= 0) continue;
+        for (auto hit : vision::matchAll(frame, *tpl, threshold, maxCount, order, 0.3, search)) {
+            hit.tag = i;
+            hits.push_back(hit);
+        }
+    }
+    if (templatePngs.size() > 1) {
+        hits = vision::suppressOverlaps(std::move(hits), 0.3, maxCount);
+        vision::sortHits(hits, order);
+    }
 
-    double minVal = 0.0, maxVal = 0.0;
-    cv::Point minLoc, maxLoc;
-    cv::minMaxLoc(result, &minVal, &maxVal, &minLoc, &maxLoc);
+    for (const auto& hit : hits) {
+        const cv::Point c = hit.center();
+        points << QPoint(int(c.x / dpr), int(c.y / dpr));
+        if (outScores) *outScores << hit.score;
+        if (outPaths) *outPaths << templatePngs[hit.tag];
+    }
+    return points;
+}
+int AutomationWorker::clickEach(const QStringList& templatePngs,
+                                double threshold,
+                                int delayMs,
+                                bool verify,
+                                const QPoint& offset,
+                                QStringList* clickedPngs,
+                                const QRect& roi,
+                                int* unverified)
+{
+    if (clickedPngs) clickedPngs->clear();
+    if (unverified) *unverified = 0;
+    auto frame = captureFrame();
+    if (!frame) return 0;
+
+    // 所有模板在同一帧上匹配（帧统计量共享）；有 roi（调用方或模板清单）的模板只在 roi 内找
+    const qreal dpr = view_->devicePixelRatioF();
+    const cv::Rect callerRoi = toFrameRect(roi, dpr);
+    const cv::Rect frameRect(0, 0, frame->width(), frame->height());
+    // roi 完全在画面外：没有可找的区域，不能退回全帧搜索
+    if (!roi.isEmpty() && (callerRoi & frameRect).area() <= 0) return 0;
+    QList<QPoint> targets;
+    QStringList targetPngs;
+    for (const QString& path : templatePngs) {
+        auto tpl = vision::TemplateRegistry::instance().get(path);
+        if (!tpl) continue;
+        const cv::Rect search = vision::searchArea(*tpl, callerRoi);
+        if (search.area() > 0 && (search & frameRect).area() <= 0) continue;
+        QPoint pt(-1, -1);
+        if (search.area() > 0) {
+            const vision::Hit hit = vision::match(*frame, *tpl, threshold, search);
+            if (hit.found) pt = QPoint(int(hit.center().x / dpr), int(hit.center().y / dpr));
+        } else {
+            double score = 0.0;
+            pt = findTemplatePlaceholder(*frame, path, &score, threshold);
+        }
+        if (pt.x() < 0) continue;
+        targets << pt + offset;
+        targetPngs << path;
+    }
 
-    if (outScore) *outScore = maxVal;
-    if (maxVal < threshold) return QPoint(-1, -1);
+    static const int kVerifyRadius = 40;      // 校验区域：点击点周围 ±40 逻辑像素
+    static const double kVerifyMinDiff = 3.0; // 平均每字节差低于该值视为画面无变化
+
+    std::shared_ptr<vision::Frame> before = frame;
+    int clicked = 0;
+    for (int i = 0; i < targets.size(); ++i) {
+        if (shouldStop("clickEach")) break;
+        if (!clickAt(targets[i])) continue;
+        if (delayMs > 0) sleepMs(delayMs);
+
+        if (verify) {
+            auto after = captureFrame();
+            if (!after) continue;
+            const cv::Rect region(int((targets[i].x() - kVerifyRadius) * dpr),
+                                  int((targets[i].y() - kVerifyRadius) * dpr),
+                                  int(2 * kVerifyRadius * dpr), int(2 * kVerifyRadius * dpr));
+            const double diff = vision::regionDifference(*before, *after, region);
+            before = after;
+            if (diff < kVerifyMinDiff) {
+                // 点击已发出但没有看到效果：不计入有效点击，单独计数
+                emit log(QStringLiteral("[clickEach] 点击后画面无变化: %1").arg(QFileInfo(targetPngs[i]).baseName()));
+                if (unverified) ++*unverified;
+                continue;
+            }
+        }
 
-    // 命中中心（当前坐标系与 screen 一致）
-    int cx = maxLoc.x + tpl.cols / 2;
-    int cy = maxLoc.y + tpl.rows / 2;
+        ++clicked;
+        if (clickedPngs) *clickedPngs << targetPngs[i];
+    }
+    return clicked;
+}
+QRect AutomationWorker::templateRegion(const QPoint& center, const QString& templatePng) const
+{
+    static const int kDefaultRadius = 40;
+    const qreal dpr = view_ ? view_->devicePixelRatioF() : 1.0;
+    int w = 2 * kDefaultRadius;
+    int h = 2 * kDefaultRadius;
+    // NOT / 自定义条件没有模板路径，不去查找，直接用默认大小
+    auto tpl = templatePng.isEmpty() ? nullptr : vision::TemplateRegistry::instance().get(templatePng);
+    if (tpl) {
+        w = qMax(1, int(tpl->width() / dpr));
+        h = qMax(1, int(tpl->height() / dpr));
+    }
+    return QRect(center.x() - w / 2, center.y() - h / 2, w, h);
+}
+bool AutomationWorker::waitRegionStable(const QRect& region, int frames, int timeoutMs, bool* changed)
+{
+    if (changed) *changed = false;
+    const cv::Rect r = toFrameRect(region, view_ ? view_->devicePixelRatioF() : 1.0);
+
+    // 从命中所在的那一帧开始比较
+    std::shared_ptr<vision::Frame> prev = lastFrame_ ? lastFrame_ : captureFrame();
+    if (!prev) return false;
+    int same = 1;
+    QElapsedTimer timer;
+    timer.start();
+    while (same < frames) {
+        if (shouldStop("waitRegionStable") || timer.elapsed() > timeoutMs) return false;
+        sleepMs(kFramePollMs);
+        auto next = captureFrame();
+        if (!next) return false;
+        if (vision::regionDifference(*prev, *next, r) < kRegionSameDiff) {
+            ++same;
+        } else {
+            same = 1;
+            if (changed) *changed = true;
+        }
+        prev = next;
+    }
+    return true;
+}
+bool AutomationWorker::clickAndSettle(const QPoint& pos, int maxWaitMs, int* waitedMs)
+{
+    if (waitedMs) *waitedMs = 0;
+    std::shared_ptr<vision::Frame> before = maxWaitMs > 0 ? captureFrame() : nullptr;
+    if (!clickAt(pos)) return false;
+    if (maxWaitMs <= 0) return true;
+
+    static const int kSettleRadius = 100;   // 观察点击点周围 ±100 逻辑像素
+    static const int kSettleFrames = 3;     // 连续 3 帧不变视为已稳定
+
+    QElapsedTimer timer;
+    timer.start();
+    const QRect region(pos.x() - kSettleRadius, pos.y() - kSettleRadius, 2 * kSettleRadius, 2 * kSettleRadius);
+    const cv::Rect r = toFrameRect(region, view_ ? view_->devicePixelRatioF() : 1.0);
+
+    // 1) 等点击点附近的画面开始变化（游戏响应了这次点击）
+    bool changed = false;
+    while (before && !changed && timer.elapsed() < maxWaitMs) {
+        if (shouldStop("clickAndSettle")) return true;
+        sleepMs(kFramePollMs);
+        auto now = captureFrame();
+        if (!now) break;
+        changed = vision::regionDifference(*before, *now, r) >= kRegionSameDiff;
+    }
+    // 2) 再等它不再变化
+    bool settled = false;
+    if (changed) {
+        const int left = maxWaitMs - int(timer.elapsed());
+        settled = left > 0 && waitRegionStable(region, kSettleFrames, left);
+    }
+    // 附近一直没有变化或到上限仍在变化：无法判断，按原固定时长等满
+    if (!settled) {
+        const int left = maxWaitMs - int(timer.elapsed());
+        if (left > 0 && !shouldStop("clickAndSettle")) sleepMs(left);
+    }
 
-    const qreal dpr = view_->devicePixelRatioF(); // 例如 1.0、1.25、1.5、2.0 等
-    QPoint localLogical( int(cx / dpr), int(cy / dpr) );
-    return localLogical;
+    const int waited = int(timer.elapsed());
+    if (waitedMs) *waitedMs = waited;
+    ++settle_.clicks;
+    if (settled) ++settle_.settled;
+    settle_.waitedMs += quint64(waited);
+    settle_.budgetMs += quint64(maxWaitMs);
+    return true;
+}
+void AutomationWorker::logSettleStats(const SettleStats& now, const SettleStats& before)
+{
+    const quint64 clicks = now.clicks - before.clicks;
+    if (clicks == 0) return;
+    const quint64 settled = now.settled - before.settled;
+    const quint64 waited = now.waitedMs - before.waitedMs;
+    const quint64 budget = now.budgetMs - before.budgetMs;
+    emit log(QStringLiteral("[稳定] 点击后等待 %1 次（%2 次提前稳定），实际 %3 ms / 固定等待 %4 ms，平均 %5 ms，节省 %6 ms")
+                 .arg(clicks).arg(settled).arg(waited).arg(budget)
+                 .arg(waited / clicks).arg(budget > waited ? budget - waited : 0));
+}
+void AutomationWorker::logTunerReport()
+{
+    // 后台调优在任务运行期间陆续完成，任务结束时把新结果写进运行日志
+    for (const QString& line : vision::TemplateTuner::instance().takeReport()) {
+        emit log(QStringLiteral("[调优] %1").arg(line));
+    }
 }
 bool AutomationWorker::shouldStop(const char* where) const
 {
@@ -210,6 +744,31 @@ void AutomationWorker::sleepMs(int ms)
     QCoreApplication::processEvents(QEventLoop::AllEvents, 5);
 }
 
+// 在 GUI 线程上向 view 发送一次左键点击
+static bool sendClick(QWebEngineView* v, const QPoint& localPos)
+{
+    if (!v) return false;
+
+    v->setFocus();
+    v->activateWindow();
+
+    QWidget* target = v->focusProxy();
+    if (!target) target = v;
+
+    QPoint vpPos = (target == v)
+                   ? localPos
+                   : target->mapFromGlobal(v->mapToGlobal(localPos));
+    QPoint globalPos = target->mapToGlobal(vpPos);
+
+    QMouseEvent press (QEvent::MouseButtonPress,  vpPos, globalPos,
+                      Qt::LeftButton, Qt::LeftButton, Qt::NoModifier);
+    QMouseEvent release(QEvent::MouseButtonRelease, vpPos, globalPos,
+                        Qt::LeftButton, Qt::NoButton,  Qt::NoModifier);
+
+    QCoreApplication::sendEvent(target, &press);
+    QCoreApplication::sendEvent(target, &release);
+    return true;
+}
 bool AutomationWorker::clickAt(const QPoint& localPos)
 {
     if (shouldStop("clickAt/pre")) return false;
@@ -222,32 +781,20 @@ bool AutomationWorker::clickAt(const QPoint& localPos)
     auto type  = isGui ? Qt::DirectConnection : Qt::BlockingQueuedConnection;
 
     QMetaObject::invokeMethod(v, [v, localPos, &ok]() {
-        if (!v) return;
-
-        v->setFocus();
-        v->activateWindow();
-
-        QWidget* target = v->focusProxy();
-        if (!target) target = v;
-
-        QPoint vpPos = (target == v)
-                           ? localPos
-                           : target->mapFromGlobal(v->mapToGlobal(localPos));
-        QPoint globalPos = target->mapToGlobal(vpPos);
-
-        QMouseEvent press (QEvent::MouseButtonPress,  vpPos, globalPos,
-                          Qt::LeftButton, Qt::LeftButton, Qt::NoModifier);
-        QMouseEvent release(QEvent::MouseButtonRelease, vpPos, globalPos,
-                            Qt::LeftButton, Qt::NoButton,  Qt::NoModifier);
-
-        QCoreApplication::sendEvent(target, &press);
-        QCoreApplication::sendEvent(target, &release);
-        ok = true;
+        ok = sendClick(v, localPos);
     }, type);
 
     if (shouldStop("clickAt/post")) return false;
     return ok;
 }
+void AutomationWorker::clickAtAsync(const QPoint& localPos, std::function<void(bool)> done)
+{
+    QPointer<QWebEngineView> v = view_;
+    if (!v || shouldStop("clickAtAsync")) { done(false); return; }
+    QMetaObject::invokeMethod(v, [v, localPos, done]() {
+        done(sendClick(v, localPos));
+    }, Qt::QueuedConnection);
+}
 
 // ===== 回到主界面（救援动作，占位实现） =====
 
@@ -290,8 +837,12 @@ void AutomationWorker::runTask(const QString& planName)
 {
     imgdsl::set_toolbox(toolbox_.get()); // 设置全局工具箱
     bool success = false; // 用于记录任务执行结果
+    const quint64 savedBefore = savedMatchCount();
+    const SettleStats settleBefore = settleStats();
     toolbox_->setTaskContext(planName);
 
+    // 第一次轮询前预加载该任务目录下的全部模板
+    toolbox_->logInfo(prefetchTaskTemplates(planName));
 
     // --- 任务调度器 ---
     if (planName == QStringLiteral("国家争霸")) {
@@ -342,6 +893,9 @@ void AutomationWorker::runTask(const QString& planName)
         toolbox_->logError(QString("未知的任务计划: %1").arg(planName));
         success = false;
     }
+    logSavedMatches(savedMatchCount() - savedBefore, savedMatchCount());
+    logSettleStats(settleStats(), settleBefore);
+    logTunerReport();
 
     // 【关键】根据任务执行结果，发出正确的信号
     if (success) {
@@ -371,7 +925,12 @@ void AutomationWorker::runScriptTask(const TaskDefinition& task) {
     }
 
     // 执行任务
+    const quint64 savedBefore = savedMatchCount();
+    const SettleStats settleBefore = settleStats();
     bool success = scriptRunner_->execute(task);
+    logSavedMatches(savedMatchCount() - savedBefore, savedMatchCount());
+    logSettleStats(settleStats(), settleBefore);
+    logTunerReport();
 
     if (success) {
         emit finished(task.name);
@@ -416,10 +975,7 @@ bool AutomationWorker::runTask_DailySignIn()
 
     // 3) 检查并点击可选的周奖励
     toolbox_->logInfo("检查周度奖励...");
-    if (auto d7 = IMG("7天"))  { CLICK(d7); SLEEP(300); }
-    if (auto d14 = IMG("14天")) { CLICK(d14); SLEEP(300); }
-    if (auto d21 = IMG("21天")) { CLICK(d21); SLEEP(300); }
-    if (auto d28 = IMG("28天")) { CLICK(d28); SLEEP(300); }
+    EACH({"7天", "14天", "21天", "28天"}, 0.85, 300);
 
     // 4) 关闭窗口
     auto closeBtn = IMG("关闭窗口");
@@ -473,19 +1029,16 @@ bool AutomationWorker::runTask_NationalContest()
         // 创建一个组合条件，代表“可以继续”的任意一种状态
         auto canContinue = ANY(challengeBtn, attackBtn, refreshBtn);
 
-        // 创建一个组合条件，代表“需要处理”的任意一种状态（继续或购买）
-        auto anyAction = ANY(canContinue, buyBtn);
-
-        MatchResult result;
-        // 等待任意一个可操作的按钮出现
-        if (!WAIT_UNTIL(anyAction, 10000, 200, &result)) {
+        // 等待任意一个可操作的按钮出现：分支 0 为继续，分支 1 为购买（次数不足）
+        enum { kContinue = 0, kBuy = 1 };
+        Selected sel = SELECT({canContinue, buyBtn}, 10000, 200);
+        if (!sel) {
             toolbox_->logError("超时：未找到“挑战”、“攻击”、“刷新”或“购买”按钮。");
             break; // 找不到任何按钮，退出循环
         }
 
-        // 判断是哪个按钮出现了
         // 情况 A: 次数用尽，出现“购买”按钮
-        if (result.which == buyBtn.name()) {
+        if (sel.index == kBuy) {
             toolbox_->logSuccess("挑战次数已用尽，任务正常结束。");
             // 点击关闭按钮，退出购买弹窗
             if (WAIT_UNTIL(closeBuyPanelBtn, 3000)) {
@@ -495,16 +1048,107 @@ bool AutomationWorker::runTask_NationalContest()
         }
 
         // 情况 B: 出现了“挑战”、“攻击”或“刷新”
-        if (canContinue.last().matched) {
-            toolbox_->logInfo(QString("找到可执行操作：%1").arg(QFileInfo(canContinue.last().which).fileName()));
-            CLICK(canContinue); // 点击找到的按钮
-            SLEEP(1500); // 点击后等待一下，让游戏响应
-        }
+        toolbox_->logInfo(QString("找到可执行操作：%1").arg(QFileInfo(sel.result.which).fileName()));
+        CLICK_SETTLE(sel, 1500); // 点击找到的按钮，等画面稳定（最多 1.5 秒）
     }
 
     toolbox_->logSuccess("“国家争霸”任务已达到最大循环次数。");
     return true;
 }
+#ifdef IMGDSL_HAS_COROUTINES
+// 协程版任务的公共开头：与 runTask 相同先预加载模板（在调度线程上阻塞加载，不占 GUI 线程）
+static imgdsl::co::Task<bool> coRunTask(imgdsl::co::Task<bool> task, QString planName)
+{
+    imgdsl::co::toolbox()->logInfo(prefetchTaskTemplates(planName));
+    co_return co_await std::move(task);
+}
+
+// 协程版“国家争霸”：流程与 runTask_NationalContest 相同，等待期间不占用线程
+static imgdsl::co::Task<bool> coTask_NationalContest()
+{
+    using namespace imgdsl::co;
+    IAsyncToolbox* tb = toolbox();
+    tb->logInfo("开始执行“国家争霸”任务（协程）...");
+
+    auto entranceBtn = IMG("国家争霸入口");
+    if (!co_await WAIT_UNTIL(entranceBtn, 8000)) {
+        tb->logError("未找到“国家争霸”入口。");
+        co_return false;
+    }
+    co_await CLICK(entranceBtn);
+
+    if (!co_await WAIT_UNTIL(IMG("国家争霸标题"), 5000)) {
+        tb->logError("进入“国家争霸”界面失败。");
+        co_return false;
+    }
+
+    const int maxLoops = 20;
+    for (int i = 0; i < maxLoops; ++i) {
+        if (tb->cancelled()) {
+            tb->logError("任务被用户手动停止。");
+            co_return false;
+        }
+        tb->logInfo(QString("开始第 %1/%2 轮挑战...").arg(i + 1).arg(maxLoops));
+
+        auto canContinue = ANY(IMG("挑战"), IMG("攻击"), IMG("刷新"));
+        auto buyBtn = IMG("购买");
+        enum { kContinue = 0, kBuy = 1 };
+        const std::vector<Condition> branches{canContinue, buyBtn};
+        Selected sel = co_await SELECT(branches, 10000, 200);
+        if (!sel) {
+            tb->logError("超时：未找到“挑战”、“攻击”、“刷新”或“购买”按钮。");
+            break;
+        }
+        if (sel.index == kBuy) {
+            tb->logSuccess("挑战次数已用尽，任务正常结束。");
+            auto closeBuyPanelBtn = IMG("关闭购买");
+            if (co_await WAIT_UNTIL(closeBuyPanelBtn, 3000)) {
+                co_await CLICK(closeBuyPanelBtn);
+            }
+            co_return true;
+        }
+        tb->logInfo(QString("找到可执行操作：%1").arg(QFileInfo(sel.result.which).fileName()));
+        co_await CLICK_SETTLE(sel, 1500);   // 点击后等画面稳定（最多 1.5 秒）
+    }
+
+    tb->logSuccess("“国家争霸”任务已达到最大循环次数。");
+    co_return true;
+}
+#endif
+
+bool AutomationWorker::hasCoroutineTask(const QString& planName)
+{
+#ifdef IMGDSL_HAS_COROUTINES
+    return planName == QStringLiteral("国家争霸");
+#else
+    Q_UNUSED(planName)
+    return false;
+#endif
+}
+
+bool AutomationWorker::startCoroutineTask(const QString& planName)
+{
+#ifdef IMGDSL_HAS_COROUTINES
+    if (!hasCoroutineTask(planName) || coToolbox_) return false;
+    coToolbox_ = std::make_unique<AWAsyncToolbox>(this, planName);
+    // 结束回调在调度线程上执行：只发信号，toolbox 交回本对象所在线程释放
+    imgdsl::co::spawn(coRunTask(coTask_NationalContest(), planName), coToolbox_->context(),
+                      [this, planName](bool ok) {
+        const quint64 saved = coToolbox_->savedMatchCount();
+        logSavedMatches(saved, saved);
+        logSettleStats(coToolbox_->settleStats(), SettleStats());
+        logTunerReport();
+        QMetaObject::invokeMethod(this, [this]() { coToolbox_.reset(); }, Qt::QueuedConnection);
+        if (ok) emit finished(planName);
+        else emit aborted(QString("任务执行失败: %1").arg(planName));
+    });
+    return true;
+#else
+    Q_UNUSED(planName)
+    return false;
+#endif
+}
+
 bool AutomationWorker::runTask_WorldContest(){
     return false;
 }
@@ -1,6 +1,7 @@
 #pragma once
 #include <QObject>
 #include <QImage>
+#include <QRect>
 #include <QPointer>
 #include <QElapsedTimer>
 #include <QDateTime>
@@ -8,12 +9,17 @@
 #include <QSharedPointer>
 #include <QStringList>
 #include <atomic>
+#include <memory>
+#include <functional>
 
 class QWebEngineView;
 struct StopToken;
 class AWToolbox;
+class AWAsyncToolbox;
 class ScriptRunner;
 struct TaskDefinition;
+namespace vision { class Frame; class MatchMemo; class IncrementalMatcher; struct CompiledTemplate; struct Hit; }
+namespace imgdsl { class ConditionStatsRegistry; }
 class AutomationWorker : public QObject
 {
     Q_OBJECT
@@ -42,17 +48,103 @@ public:
     bool clickAt(const QPoint& localPos);               // GUI 线程点击（左键）
     static void sleepMs(int ms);
     QImage capture();
+    // 非阻塞截图/点击（协程版任务使用）：投递到 GUI 线程执行，完成后在 GUI 线程回调 done；
+    // 截图回调同时带上截图时的设备像素比，调用方不必在其他线程上访问 view
+    void captureAsync(std::function<void(QImage, qreal dpr)> done);
+    void clickAtAsync(const QPoint& localPos, std::function<void(bool)> done);
+    // 协程版任务：在共享调度线程上运行，不占用独立线程；planName 没有协程版时返回 false
+    static bool hasCoroutineTask(const QString& planName);
+    bool startCoroutineTask(const QString& planName);
+    std::shared_ptr<vision::Frame> captureFrame();    // 截图并转为可共享统计量的帧
     QPoint findTemplatePlaceholder(const QImage& img,
                                    const QString& templatePng,
                                    double* outScore,
                                    double threshold);
+    QPoint findTemplatePlaceholder(const vision::Frame& frame,
+                                   const QString& templatePng,
+                                   double* outScore,
+                                   double threshold);
+    // 帧像素坐标的最佳匹配；memo / incremental 由调用方提供，每个执行线程（工作线程、协程任务）各用一份
+    vision::Hit findTemplateHit(const vision::Frame& frame,
+                                const QString& templatePng,
+                                double threshold,
+                                vision::MatchMemo& memo,
+                                vision::IncrementalMatcher& incremental);
+    // 颜色变体模板族：一次形状匹配 + 色相分类，outVariant 返回命中的变体路径；roi（逻辑坐标）非空时只在其中搜索
+    QPoint findFamilyPlaceholder(const vision::Frame& frame,
+                                 const QStringList& variantPngs,
+                                 double* outScore,
+                                 double threshold,
+                                 QString* outVariant,
+                                 const QRect& roi = QRect());
+    // 多目标：同一帧上找出 templatePngs 的所有实例（非极大值抑制后最多 maxCount 个），
+    // 按位置（从上到下、从左到右）或得分排序，返回逻辑坐标中心点。
+    // roi（逻辑坐标）非空时只在其中搜索（完全在画面外时没有结果），否则用模板清单中的区域
+    QList<QPoint> findAllTemplatePlaceholders(const vision::Frame& frame,
+                                              const QStringList& templatePngs,
+                                              double threshold,
+                                              int maxCount,
+                                              bool sortByScore = false,
+                                              QList<double>* outScores = nullptr,
+                                              QStringList* outPaths = nullptr,
+                                              const QRect& roi = QRect());
+    // 一帧批量检测 templatePngs（每个模板取最佳匹配），按列表顺序逐个点击命中位置；
+    // verify 时对比点击前后点击点附近的画面。返回经过校验的有效点击数（不校验时即点击数），
+    // 已点击但画面无变化的次数写入 unverified。roi 同上；roi 完全在画面外时不点击
+    int clickEach(const QStringList& templatePngs,
+                  double threshold,
+                  int delayMs,
+                  bool verify,
+                  const QPoint& offset = QPoint(),
+                  QStringList* clickedPngs = nullptr,
+                  const QRect& roi = QRect(),
+                  int* unverified = nullptr);
+    // 帧序列稳定检测：从最近一帧起连续截图，region（逻辑坐标，为空时整帧）连续 frames 帧像素不变即返回 true；
+    // changed 返回期间该区域是否变化过。超时或停止返回 false
+    bool waitRegionStable(const QRect& region, int frames, int timeoutMs, bool* changed = nullptr);
+    // 模板命中区域（逻辑坐标）：以 center 为中心、模板大小；templatePng 为空或模板不可用时取中心周围 ±40 像素
+    QRect templateRegion(const QPoint& center, const QString& templatePng) const;
+    // 点击后等画面稳定：先等点击点附近开始变化，再等它连续几帧不变；maxWaitMs 为上限（原固定等待时长），
+    // 附近一直没有变化时等满上限。waitedMs 返回实际等待时长
+    bool clickAndSettle(const QPoint& pos, int maxWaitMs, int* waitedMs = nullptr);
+    // 点击后等待的累计统计（本窗口）
+    struct SettleStats {
+        quint64 clicks = 0;
+        quint64 settled = 0;    // 提前稳定的次数
+        quint64 waitedMs = 0;   // 实际等待
+        quint64 budgetMs = 0;   // 原固定等待
+    };
+    SettleStats settleStats() const { return settle_; }
+    // 单次模板匹配的时间预算（毫秒，<=0 表示不限）：超时返回目前最佳结果
+    void setMatchBudgetMs(int ms) { matchBudgetMs_ = ms; }
+    // 静止画面上复用匹配结果而省掉的匹配次数（本窗口累计）
+    quint64 savedMatchCount() const;
+    // 本窗口的条件运行统计（ANY / ALL 自适应顺序用），同步与协程版任务共用
+    imgdsl::ConditionStatsRegistry* conditionStats() const { return conditionStats_.get(); }
     QString saveScreenshot(const QString& dir, const QString& tag);
     bool returnToHome(int maxMs = 8000);
 private:
     QPointer<QWebEngineView> view_;
     QSharedPointer<StopToken> stop_;
     std::unique_ptr<AWToolbox> toolbox_;
+    std::unique_ptr<AWAsyncToolbox> coToolbox_;     // 协程版任务的工具接口（运行期间存活）
     std::unique_ptr<ScriptRunner> scriptRunner_;
+    // 以下两项只供工作线程上的任务使用；协程版任务在 AWAsyncToolbox 里各有一份
+    std::unique_ptr<vision::MatchMemo> memo_;   // 按帧内容哈希缓存的匹配结果
+    std::unique_ptr<vision::IncrementalMatcher> incremental_;   // 相邻帧之间只重算变化区域
+    std::unique_ptr<imgdsl::ConditionStatsRegistry> conditionStats_;
+    int matchBudgetMs_ = 200;
+    std::shared_ptr<vision::Frame> lastFrame_;  // 最近一次截图，帧序列比较的起点
+    SettleStats settle_;
+
+    // complete 为 false 表示匹配受时间预算截断，结果只是目前最佳，不可缓存
+    vision::Hit matchTemplateHit(const vision::Frame& frame, const QString& tplPath,
+                                 const std::shared_ptr<const vision::CompiledTemplate>& tpl,
+                                 double threshold, vision::IncrementalMatcher& incremental,
+                                 bool* complete = nullptr);
+    void logSavedMatches(quint64 saved, quint64 total);
+    void logSettleStats(const SettleStats& now, const SettleStats& before);
+    void logTunerReport();
 
 
     bool runTask_NationalContest();
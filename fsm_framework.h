@@ -9,6 +9,8 @@
 #include <QDebug>
 #include <QElapsedTimer>
 #include <QThread>
+#include <QTimer>
+#include <QVariant>
 
 namespace fsm {
 
@@ -29,6 +31,16 @@ enum class TransitionResult {
 using TransitionCondition = std::function<bool(Context*)>;
 using StateAction = std::function<TransitionResult(Context*)>;
 
+// 异步调度：delayMs 毫秒后在调度方的线程上调用 task（Qt 事件循环、协程调度器等）
+using Scheduler = std::function<void(int delayMs, std::function<void()> task)>;
+
+// 用 context 所在线程的事件循环调度；context 销毁后未触发的回调自动丢弃
+inline Scheduler qtScheduler(QObject* context) {
+    return [context](int delayMs, std::function<void()> task) {
+        QTimer::singleShot(qMax(0, delayMs), context, std::move(task));
+    };
+}
+
 // 任务上下文 - 存储任务执行中的所有数据
 class Context {
 public:
@@ -45,7 +57,7 @@ public:
     // 获取/设置数据的便捷方法
     template<typename T>
     T get(const QString& key, const T& defaultValue = T()) const {
-        return data.value(key, defaultValue).value<T>();
+        return data.value(key, QVariant::fromValue(defaultValue)).template value<T>();
     }
 
     void set(const QString& key, const QVariant& value) {
@@ -86,8 +98,9 @@ public:
     StateAction onExecute;                 // 状态主逻辑
     StateAction onExit;                    // 退出状态时执行
     QMap<TransitionResult, Transition> transitions;  // 状态转换映射
-    int maxRetries = 3;                    // 最大重试次数
+    int maxRetries = 3;                    // 最大重试次数；也是监视者连续处理的上限（见 Watcher）
     int retryDelayMs = 1000;              // 重试延迟
+    int timeoutMs = 0;                     // 状态超时(含所有重试)，0 表示不限
 
     State(const QString& stateName) : name(stateName) {}
 
@@ -110,7 +123,7 @@ public:
     State& addTransition(TransitionResult result,
                          const QString& targetState,
                          const QString& description = QString()) {
-        transitions[result] = Transition(targetState, nullptr, description);
+        transitions.insert(result, Transition(targetState, nullptr, description));
         return *this;
     }
 
@@ -118,6 +131,35 @@ public:
         maxRetries = retries;
         return *this;
     }
+
+    State& setRetryDelay(int delayMs) {
+        retryDelayMs = delayMs;
+        return *this;
+    }
+
+    State& setTimeout(int ms) {
+        timeoutMs = ms;
+        return *this;
+    }
+};
+
+// 并行区域里的监视者（随机弹窗、断线画面、每日重置横幅…）：
+// 与主区域正交，每个 tick 在同一帧上检查 guard，按添加顺序第一个成立的执行 action。
+// 监视者连续处理（期间主逻辑一次也没执行）超过当前状态的 maxRetries 次，视为画面处理不掉，状态按 Failed 转换
+struct Watcher {
+    QString name;
+    TransitionCondition guard;     // 在本 tick 的共享帧上判断
+    StateAction action;            // 处理画面(如点关闭)；返回 Failed 视为主区域当前状态失败
+    QString preemptTo;             // 非空：主区域退出当前状态并转到此状态；空：处理完继续当前状态
+    int settleMs = 300;            // 处理后等画面恢复再开始下一个 tick
+
+    Watcher(const QString& watcherName,
+            TransitionCondition cond,
+            StateAction handler,
+            const QString& preemptState = QString(),
+            int settleDelayMs = 300)
+        : name(watcherName), guard(cond), action(handler),
+          preemptTo(preemptState), settleMs(settleDelayMs) {}
 };
 
 // 状态机
@@ -146,7 +188,17 @@ public:
         completedState_ = stateName;
     }
 
-    // 运行状态机
+    // 每个 tick（每次状态尝试前）调用一次，截图并存放到 context 或外部共享帧；
+    // 监视者和主区域的状态逻辑都读这一帧，不再各自截图
+    void setFrameSource(std::function<void(Context*)> source) {
+        frameSource_ = source;
+    }
+
+    void addWatcher(const Watcher& watcher) {
+        watchers_.append(watcher);
+    }
+
+    // 阻塞运行状态机（在调用线程上执行，重试间隔用 sleep）
     bool run(Context* context, std::function<bool()> shouldStop = nullptr) {
         if (!context) return false;
 
@@ -172,8 +224,43 @@ public:
                 return false;
             }
 
-            // 执行状态
-            TransitionResult result = executeState(state, context);
+            // 执行状态，重试和监视者处理都在循环内完成
+            context->stateTimer.start();
+            TransitionResult result = TransitionResult::Failed;
+            bool timedOut = false;
+            int handled = 0;
+            QString preemptTo;
+            for (;;) {
+                int delay = 0;
+                const TickOutcome tick = beginTick(context, &delay, &preemptTo);
+                if (tick == TickOutcome::Failed || tick == TickOutcome::Preempted) break;
+                // 监视者一直在处理画面时主逻辑不执行，状态超时与连续处理上限都要在这里生效
+                if (tick == TickOutcome::Handled) {
+                    if (stateExpired(state, context)) {
+                        result = stateTimedOut(state, context);
+                        break;
+                    }
+                    if (tooManyHandles(state, &handled)) break;
+                }
+                if (tick == TickOutcome::Proceed) {
+                    handled = 0;
+                    result = timedOut ? stateTimedOut(state, context)
+                                      : attemptState(state, context);
+                    if (result != TransitionResult::Retry) break;
+                    delay = retryDelay(state, context, &timedOut);
+                }
+                if (delay > 0) QThread::msleep(delay);
+                if (shouldStop && shouldStop()) {
+                    logCallback_(QString("[%1] 收到停止信号").arg(name_));
+                    return false;
+                }
+            }
+            exitState(state, context);
+
+            if (!preemptTo.isEmpty()) {
+                preempt(preemptTo);
+                continue;
+            }
 
             // 处理状态转换
             if (!handleTransition(state, result, context)) {
@@ -186,6 +273,43 @@ public:
         return true;
     }
 
+    // 异步运行状态机：立即返回，每个状态、每次重试都由 scheduler 调度，
+    // 重试间隔和状态超时是定时器而不是 sleep，同一线程可以并发跑多个状态机。
+    // 所有回调都在 scheduler 的线程上执行；结束时调用 done（成功为 true）。
+    // context 须存活到 done 被调用；状态机可以提前销毁（在 scheduler 线程上），未触发的回调自动作废。
+    void start(Context* context, Scheduler scheduler,
+               std::function<void(bool ok)> done = nullptr,
+               std::function<bool()> shouldStop = nullptr) {
+        if (!context || !scheduler) {
+            if (done) done(false);
+            return;
+        }
+
+        ++*generation_;
+        running_ = true;
+        inState_ = false;
+        currentState_ = initialState_;
+        context_ = context;
+        scheduler_ = std::move(scheduler);
+        done_ = std::move(done);
+        shouldStop_ = std::move(shouldStop);
+        context->totalTimer.start();
+
+        logCallback_(QString("[%1] 状态机启动(异步)，初始状态: %2")
+                         .arg(name_).arg(currentState_));
+        schedule(0, &StateMachine::step);
+    }
+
+    // 停止异步运行：已调度的回调全部作废，不再调用 done
+    void stop() {
+        ++*generation_;
+        running_ = false;
+        inState_ = false;
+        done_ = nullptr;
+    }
+
+    bool isRunning() const { return running_; }
+
     // 设置日志回调
     void setLogCallback(std::function<void(const QString&)> callback) {
         logCallback_ = callback;
@@ -195,9 +319,8 @@ public:
     QString getCurrentState() const { return currentState_; }
 
 private:
-    TransitionResult executeState(std::shared_ptr<State> state, Context* context) {
-        context->stateTimer.start();
-
+    // 一次尝试：onEnter + onExecute。返回 Retry 表示还有重试次数，由调用方安排下一次尝试
+    TransitionResult attemptState(const std::shared_ptr<State>& state, Context* context) {
         // 进入状态
         if (state->onEnter) {
             logCallback_(QString("[%1] → 进入状态: %2")
@@ -220,10 +343,6 @@ private:
                     logCallback_(QString("[%1] ↻ 重试状态 %2 (%3/%4)")
                                      .arg(name_).arg(state->name)
                                      .arg(retries + 1).arg(state->maxRetries));
-                    if (state->retryDelayMs > 0) {
-                        QThread::msleep(state->retryDelayMs);
-                    }
-                    return executeState(state, context); // 递归重试
                 } else {
                     logCallback_(QString("[%1] ✗ 状态 %2 重试次数已达上限")
                                      .arg(name_).arg(state->name));
@@ -231,7 +350,73 @@ private:
                 }
             }
         }
+        return result;
+    }
+
+    enum class TickOutcome {
+        Proceed,        // 无监视者触发，主区域照常执行
+        Handled,        // 监视者处理了画面，等 delay 后重新开始本 tick
+        Preempted,      // 监视者要求主区域转到 preemptTo
+        Failed          // 监视者处理失败，主区域当前状态按 Failed 转换
+    };
+
+    // tick 开始：截一次共享帧，依次检查监视者
+    TickOutcome beginTick(Context* context, int* delayMs, QString* preemptTo) {
+        if (frameSource_) frameSource_(context);
+        for (const Watcher& w : watchers_) {
+            if (!w.guard || !w.guard(context)) continue;
+            logCallback_(QString("[%1] ⚡ 监视者 %2 触发（状态 %3）")
+                             .arg(name_).arg(w.name).arg(currentState_));
+            const TransitionResult r = w.action ? w.action(context) : TransitionResult::Success;
+            if (r == TransitionResult::Failed) {
+                logCallback_(QString("[%1] ✗ 监视者 %2 处理失败").arg(name_).arg(w.name));
+                return TickOutcome::Failed;
+            }
+            if (!w.preemptTo.isEmpty()) {
+                *preemptTo = w.preemptTo;
+                return TickOutcome::Preempted;
+            }
+            *delayMs = qMax(0, w.settleMs);
+            return TickOutcome::Handled;
+        }
+        return TickOutcome::Proceed;
+    }
+
+    void preempt(const QString& target) {
+        logCallback_(QString("[%1] 状态抢占: %2 → %3").arg(name_).arg(currentState_).arg(target));
+        currentState_ = target;
+    }
+
+    // 下一次重试前的等待时间；赶不上状态超时则返回到超时时刻的剩余时间并置 timedOut
+    int retryDelay(const std::shared_ptr<State>& state, Context* context, bool* timedOut) const {
+        const int delay = qMax(0, state->retryDelayMs);
+        *timedOut = false;
+        if (state->timeoutMs <= 0) return delay;
+        const qint64 remaining = state->timeoutMs - context->stateTimer.elapsed();
+        if (remaining > delay) return delay;
+        *timedOut = true;
+        return static_cast<int>(qMax<qint64>(0, remaining));
+    }
 
+    // 又一次监视者处理；连续处理超过 maxRetries 次返回 true（调用方按 Failed 离开状态）
+    bool tooManyHandles(const std::shared_ptr<State>& state, int* handled) {
+        if (++*handled <= state->maxRetries) return false;
+        logCallback_(QString("[%1] ✗ 状态 %2 监视者连续处理 %3 次画面仍未恢复")
+                         .arg(name_).arg(state->name).arg(*handled));
+        return true;
+    }
+
+    bool stateExpired(const std::shared_ptr<State>& state, Context* context) const {
+        return state->timeoutMs > 0 && context->stateTimer.elapsed() >= state->timeoutMs;
+    }
+
+    TransitionResult stateTimedOut(const std::shared_ptr<State>& state, Context* context) {
+        logCallback_(QString("[%1] ✗ 状态 %2 超时 (%3ms)")
+                         .arg(name_).arg(state->name).arg(context->stateTimer.elapsed()));
+        return TransitionResult::Failed;
+    }
+
+    void exitState(const std::shared_ptr<State>& state, Context* context) {
         // 退出状态
         if (state->onExit) {
             logCallback_(QString("[%1] ← 退出状态: %2 (耗时: %3ms)")
@@ -241,13 +426,104 @@ private:
         }
 
         // 重置重试计数
-        if (result != TransitionResult::Retry) {
-            context->resetRetry(state->name);
+        context->resetRetry(state->name);
+    }
+
+    // 异步驱动：回调带上代号，stop()、重新 start() 或状态机销毁后旧回调直接丢弃
+    void schedule(int delayMs, void (StateMachine::*fn)()) {
+        const std::weak_ptr<quint64> token = generation_;
+        const quint64 gen = *generation_;
+        scheduler_(delayMs, [this, token, gen, fn]() {
+            const auto current = token.lock();
+            if (current && *current == gen && running_) (this->*fn)();
+        });
+    }
+
+    void finish(bool ok) {
+        running_ = false;
+        inState_ = false;
+        ++*generation_;
+        auto done = std::move(done_);
+        done_ = nullptr;
+        if (done) done(ok);
+    }
+
+    // 每次回调只做一次尝试或一次转换，然后把控制权交还事件循环
+    void step() {
+        if (shouldStop_ && shouldStop_()) {
+            logCallback_(QString("[%1] 收到停止信号").arg(name_));
+            finish(false);
+            return;
+        }
+        if (currentState_ == completedState_) {
+            logCallback_(QString("[%1] 状态机完成，总耗时: %2ms")
+                             .arg(name_).arg(context_->totalTimer.elapsed()));
+            finish(true);
+            return;
         }
 
-        return result;
+        auto state = states_.value(currentState_);
+        if (!state) {
+            logCallback_(QString("[%1] 错误：未找到状态 %2")
+                             .arg(name_).arg(currentState_));
+            finish(false);
+            return;
+        }
+
+        if (!inState_) {
+            inState_ = true;
+            timedOut_ = false;
+            handled_ = 0;
+            context_->stateTimer.start();
+        }
+
+        int delay = 0;
+        QString preemptTo;
+        switch (beginTick(context_, &delay, &preemptTo)) {
+        case TickOutcome::Failed:
+            leaveState(state, TransitionResult::Failed);
+            return;
+        case TickOutcome::Preempted:
+            exitState(state, context_);
+            inState_ = false;
+            preempt(preemptTo);
+            schedule(0, &StateMachine::step);
+            return;
+        case TickOutcome::Handled:
+            if (stateExpired(state, context_)) {
+                leaveState(state, stateTimedOut(state, context_));
+                return;
+            }
+            if (tooManyHandles(state, &handled_)) {
+                leaveState(state, TransitionResult::Failed);
+                return;
+            }
+            schedule(delay, &StateMachine::step);
+            return;
+        case TickOutcome::Proceed:
+            handled_ = 0;
+            break;
+        }
+
+        // 超时的定时器到点时直接判失败
+        TransitionResult result = timedOut_ ? stateTimedOut(state, context_)
+                                            : attemptState(state, context_);
+        if (result == TransitionResult::Retry) {
+            schedule(retryDelay(state, context_, &timedOut_), &StateMachine::step);
+            return;
+        }
+        leaveState(state, result);
     }
 
+    void leaveState(const std::shared_ptr<State>& state, TransitionResult result) {
+        exitState(state, context_);
+        inState_ = false;
+        if (!handleTransition(state, result, context_)) {
+            finish(false);
+            return;
+        }
+        schedule(0, &StateMachine::step);
+    }
     bool handleTransition(std::shared_ptr<State> state,
                           TransitionResult result,
                           Context* context) {
@@ -297,6 +573,21 @@ private:
     QString errorState_;
     QString completedState_;
     bool running_;
+
+    // 异步运行状态
+    Context* context_ = nullptr;
+    Scheduler scheduler_;
+    std::function<void(bool)> done_;
+    std::function<bool()> shouldStop_;
+    std::shared_ptr<quint64> generation_ = std::make_shared<quint64>(0);
+    bool inState_ = false;
+    bool timedOut_ = false;
+    int handled_ = 0;       // 当前状态里监视者连续处理的次数
+
+    // 并行区域
+    std::function<void(Context*)> frameSource_;
+    QList<Watcher> watchers_;
+
     std::function<void(const QString&)> logCallback_ = [](const QString& msg) {
         qDebug() << msg;
     };
@@ -0,0 +1,274 @@
+#ifndef FSM_STATIC_H
+#define FSM_STATIC_H
+
+// 编译期状态表版本的状态机
+// 状态是枚举值（必须以 Count 结尾），转换表是 constexpr 数组，上下文是任务自己的结构体。
+// 运行时按枚举下标查表、调函数指针：没有字符串查找、QVariant 装箱和堆分配。
+// 需要脚本化/动态拼装的状态机仍用 fsm_framework.h 里的 fsm::StateMachine。
+//
+//   enum class S { Open, Fight, Done, Error, Count };
+//   struct Ctx { int rounds = 0; };
+//   constexpr fsm::fixed::Definition<S, Ctx> kDef{
+//       {{ {S::Open, "打开", &openPanel}, {S::Fight, "战斗", &fight, 5, 500},
+//          {S::Done, "完成"}, {S::Error, "错误", &recover} }},
+//       fsm::fixed::makeTable<S>({ {S::Open, fsm::TransitionResult::Success, S::Fight},
+//                                 {S::Fight, fsm::TransitionResult::Success, S::Done} }),
+//       S::Open, S::Done, S::Error};
+//   static_assert(kDef.valid(), "状态表必须按枚举顺序排列");
+//
+//   Ctx ctx;
+//   fsm::fixed::Machine<S, Ctx> m(kDef);
+//   m.run(ctx, [&]() { return stopToken.isStopped(); });
+
+#include "fsm_framework.h"
+#include <array>
+#include <cstddef>
+
+namespace fsm {
+namespace fixed {
+
+constexpr std::size_t kResultCount = 4;
+
+constexpr std::size_t resultIndex(TransitionResult r) {
+    return static_cast<std::size_t>(r);
+}
+
+template <typename S>
+constexpr std::size_t stateIndex(S s) {
+    return static_cast<std::size_t>(s);
+}
+
+template <typename S>
+constexpr std::size_t stateCount() {
+    return static_cast<std::size_t>(S::Count);
+}
+
+// 转换表的一行
+template <typename S>
+struct Row {
+    S from;
+    TransitionResult result;
+    S to;
+};
+
+// 状态定义；execute 为空的状态（通常是完成状态）直接按 Failed 处理
+template <typename S, typename Ctx>
+struct StateSpec {
+    S id;
+    const char* name;
+    TransitionResult (*execute)(Ctx&) = nullptr;
+    int maxRetries = 3;
+    int retryDelayMs = 1000;
+    int timeoutMs = 0;      // 含所有重试，0 表示不限
+};
+
+// [状态][结果] → 目标状态；S::Count 表示未定义
+template <typename S>
+using Table = std::array<std::array<S, kResultCount>, stateCount<S>()>;
+
+template <typename S, std::size_t N>
+constexpr Table<S> makeTable(const Row<S> (&rows)[N]) {
+    Table<S> table{};
+    for (auto& row : table) {
+        for (auto& to : row) to = S::Count;
+    }
+    for (const Row<S>& r : rows) {
+        table[stateIndex(r.from)][resultIndex(r.result)] = r.to;
+    }
+    return table;
+}
+
+template <typename S, typename Ctx>
+struct Definition {
+    std::array<StateSpec<S, Ctx>, stateCount<S>()> states;
+    Table<S> table;
+    S initial;
+    S completed;
+    S error = S::Count;     // Failed 没有显式转换时的去向
+
+    // 状态定义按枚举顺序排列、起止状态合法
+    constexpr bool valid() const {
+        for (std::size_t i = 0; i < states.size(); ++i) {
+            if (stateIndex(states[i].id) != i) return false;
+        }
+        return initial != S::Count && completed != S::Count;
+    }
+
+    // 与 StateMachine::handleTransition 一致：显式转换优先，Failed 默认去错误状态，Completed 默认结束
+    constexpr S next(S from, TransitionResult r) const {
+        const S to = table[stateIndex(from)][resultIndex(r)];
+        if (to != S::Count) return to;
+        if (r == TransitionResult::Failed) return error;
+        if (r == TransitionResult::Completed) return completed;
+        return S::Count;
+    }
+};
+
+// 运行实例：只保存当前状态、重试次数和计时器，定义本身是 constexpr 数据
+template <typename S, typename Ctx>
+class Machine {
+public:
+    // 一次 tick 的结果
+    struct Tick {
+        bool finished = false;
+        bool ok = false;
+        int delayMs = 0;    // 下一次 tick 前应等待的时间
+    };
+
+    explicit Machine(const Definition<S, Ctx>& def, const QString& machineName = "FSM")
+        : def_(def), name_(machineName) {
+        reset();
+    }
+
+    void reset() {
+        current_ = def_.initial;
+        entered_ = false;
+        timedOut_ = false;
+        retries_ = 0;
+    }
+
+    // 只在转换、重试和出错时写日志；不设置则不产生任何字符串
+    void setLogCallback(std::function<void(const QString&)> callback) {
+        logCallback_ = std::move(callback);
+    }
+
+    S current() const { return current_; }
+
+    // 执行当前状态一次并完成转换；由调用方决定如何等待 delayMs
+    Tick tick(Ctx& ctx) {
+        if (current_ == def_.completed) return {true, true, 0};
+
+        const StateSpec<S, Ctx>& spec = def_.states[stateIndex(current_)];
+        if (!entered_) {
+            entered_ = true;
+            timedOut_ = false;
+            retries_ = 0;
+            stateTimer_.start();
+        }
+
+        TransitionResult result = TransitionResult::Failed;
+        if (timedOut_) {
+            logf([&]() { return QString("[%1] ✗ 状态 %2 超时 (%3ms)").arg(name_).arg(spec.name).arg(stateTimer_.elapsed()); });
+        } else if (spec.execute) {
+            result = spec.execute(ctx);
+        }
+
+        if (result == TransitionResult::Retry) {
+            if (retries_ < spec.maxRetries) {
+                ++retries_;
+                logf([&]() { return QString("[%1] ↻ 重试状态 %2 (%3/%4)").arg(name_).arg(spec.name).arg(retries_).arg(spec.maxRetries); });
+                int delay = qMax(0, spec.retryDelayMs);
+                if (spec.timeoutMs > 0) {
+                    const qint64 remaining = spec.timeoutMs - stateTimer_.elapsed();
+                    if (remaining <= delay) {
+                        timedOut_ = true;
+                        delay = static_cast<int>(qMax<qint64>(0, remaining));
+                    }
+                }
+                return {false, false, delay};
+            }
+            logf([&]() { return QString("[%1] ✗ 状态 %2 重试次数已达上限").arg(name_).arg(spec.name); });
+            result = TransitionResult::Failed;
+        }
+
+        const S next = def_.next(current_, result);
+        entered_ = false;
+        if (next == S::Count) {
+            logf([&]() { return QString("[%1] 错误：状态 %2 没有定义结果 %3 的转换").arg(name_).arg(spec.name).arg(static_cast<int>(result)); });
+            return {true, false, 0};
+        }
+        logf([&]() { return QString("[%1] 状态转换: %2 → %3").arg(name_).arg(spec.name).arg(def_.states[stateIndex(next)].name); });
+        current_ = next;
+        return {current_ == def_.completed, current_ == def_.completed, 0};
+    }
+
+    // 阻塞运行（在调用线程上 sleep）
+    bool run(Ctx& ctx, const std::function<bool()>& shouldStop = nullptr) {
+        reset();
+        for (;;) {
+            if (shouldStop && shouldStop()) {
+                logf([&]() { return QString("[%1] 收到停止信号").arg(name_); });
+                return false;
+            }
+            const Tick t = tick(ctx);
+            if (t.finished) return t.ok;
+            if (t.delayMs > 0) QThread::msleep(t.delayMs);
+        }
+    }
+
+    // 异步运行，语义同 StateMachine::start：ctx 须存活到 done 被调用，机器可提前销毁
+    void start(Ctx& ctx, Scheduler scheduler,
+               std::function<void(bool ok)> done = nullptr,
+               std::function<bool()> shouldStop = nullptr) {
+        reset();
+        ++*generation_;
+        ctx_ = &ctx;
+        scheduler_ = std::move(scheduler);
+        done_ = std::move(done);
+        shouldStop_ = std::move(shouldStop);
+        schedule(0);
+    }
+
+    void stop() {
+        ++*generation_;
+        done_ = nullptr;
+    }
+
+private:
+    // 没有设置日志回调时不格式化消息：make 只在需要输出时调用
+    template <typename Make>
+    void logf(Make make) {
+        if (logCallback_) logCallback_(make());
+    }
+
+    void schedule(int delayMs) {
+        const std::weak_ptr<quint64> token = generation_;
+        const quint64 gen = *generation_;
+        scheduler_(delayMs, [this, token, gen]() {
+            const auto current = token.lock();
+            if (current && *current == gen) step();
+        });
+    }
+
+    void step() {
+        if (shouldStop_ && shouldStop_()) {
+            logf([&]() { return QString("[%1] 收到停止信号").arg(name_); });
+            finish(false);
+            return;
+        }
+        const Tick t = tick(*ctx_);
+        if (t.finished) {
+            finish(t.ok);
+            return;
+        }
+        schedule(t.delayMs);
+    }
+
+    void finish(bool ok) {
+        ++*generation_;
+        auto done = std::move(done_);
+        done_ = nullptr;
+        if (done) done(ok);
+    }
+
+    const Definition<S, Ctx>& def_;
+    QString name_;
+    S current_;
+    bool entered_ = false;
+    bool timedOut_ = false;
+    int retries_ = 0;
+    QElapsedTimer stateTimer_;
+    std::function<void(const QString&)> logCallback_;
+
+    // 异步运行状态
+    Ctx* ctx_ = nullptr;
+    Scheduler scheduler_;
+    std::function<void(bool)> done_;
+    std::function<bool()> shouldStop_;
+    std::shared_ptr<quint64> generation_ = std::make_shared<quint64>(0);
+};
+
+} // namespace fixed
+} // namespace fsm
+
+#endif // FSM_STATIC_H
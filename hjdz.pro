@@ -2,7 +2,8 @@ QMAKE_PROJECT_DEPTH = 0
 
 QT += core gui widgets webenginewidgets
 
-CONFIG += c++17
+# imgdsl_co.h 的协程需要 C++20；以 C++17 编译时协程版任务自动关闭，其余不受影响
+CONFIG += c++2a
 QMAKE_ENV += chcp 936
 FORMS += mainwindow.ui
 
@@ -18,7 +19,11 @@ SOURCES += \
     scriptrunner.cpp \
     screencapture.cpp \
     taskeditor.cpp \
-    stepwidget.cpp
+    stepwidget.cpp \
+    templatematcher.cpp \
+    scenerecognizer.cpp \
+    templatetuner.cpp \
+    templatepack.cpp
 
 HEADERS += \
     SilentWebPage.h \
@@ -26,14 +31,20 @@ HEADERS += \
     automationpanel.h \
     automationworker.h \
     fsm_framework.h \
+    fsm_static.h \
     imgdsl_qt.h \
+    imgdsl_co.h \
     mainwindow.h \
     mywebpage.h \
     taskmodel.h \
     scriptrunner.h \
     screencapture.h \
     taskeditor.h \
-    stepwidget.h
+    stepwidget.h \
+    templatematcher.h \
+    scenerecognizer.h \
+    templatetuner.h \
+    templatepack.h
 
 # Use UTF-8 for MSVC so Chinese strings are safe
 QMAKE_CXXFLAGS += /utf-8
@@ -0,0 +1,579 @@
+#ifndef IMGDSL_CO_H
+#define IMGDSL_CO_H
+#pragma once
+
+// imgdsl 协程版（C++20）
+// co_await WAIT_UNTIL / SELECT / CLICK / SLEEP 挂起协程而不阻塞线程：截图、点击投递到 GUI 线程，
+// 等待用定时器实现，匹配在少量共享调度线程上进行，几个线程即可同时跑大量窗口的任务。
+// 阻塞版（imgdsl_qt.h、runTask_*）不受影响，两者并存，任务可以逐个迁移。
+//
+//   imgdsl::co::Task<bool> myTask() {
+//       using namespace imgdsl::co;
+//       auto btn = IMG("挑战");
+//       if (!co_await WAIT_UNTIL(btn, 8000)) co_return false;
+//       co_await CLICK_SETTLE(btn, 1500);
+//       co_return true;
+//   }
+//
+// 条件树中的 APPEAR / NOT / ANY / ALL 在协程截取的帧上批量匹配；
+// FAMILY、STABILIZED 与自定义函数（Opaque）只能走阻塞版工具接口，协程版 WAIT_UNTIL / SELECT 遇到时报错并返回失败。
+// 协程的参数都按值传递：Task 是惰性的，引用参数到开始执行时可能已经失效。
+
+#include "imgdsl_qt.h"
+
+#if defined(__cpp_impl_coroutine) && __has_include(<coroutine>)
+#define IMGDSL_HAS_COROUTINES 1
+
+#include <coroutine>
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <vector>
+#include <exception>
+#include <utility>
+#include <optional>
+#include <deque>
+#include <queue>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QThread>
+
+namespace imgdsl::co {
+
+// =============== 异步工具接口（每个窗口任务一个） ===============
+struct IAsyncToolbox {
+    virtual ~IAsyncToolbox() = default;
+    // 投递一次截图，不阻塞；截到后（任意线程）调用 done，ok 表示是否拿到画面
+    virtual void requestFrame(std::function<void(bool ok)> done) = 0;
+    // 在最近一次截图上批量匹配，结果与 queries 一一对应；在调度线程上调用，只占 CPU 不等待
+    virtual std::vector<MatchResult> matchBatch(const std::vector<LeafQuery>& queries) = 0;
+    // 投递一次点击（逻辑坐标），完成后调用 done
+    virtual void requestClick(const QPoint& logicalPt, std::function<void(bool ok)> done) = 0;
+    // 点击后等画面稳定（CLICK_SETTLE）用：把最近一次截图记为比较基准；
+    // 最近一次截图在 center 周围 ±radius（逻辑坐标）内是否与基准不同
+    virtual void markFrame() = 0;
+    virtual bool regionChanged(const QPoint& center, int radius) = 0;
+    // 一次 CLICK_SETTLE 的实际等待与上限，供任务结束时统计
+    virtual void recordSettle(int /*waitedMs*/, bool /*settled*/, int /*maxWaitMs*/) {}
+    virtual bool cancelled() const = 0;
+    virtual void logAction(const QString& action, const QString& conditionName, int timeout = -1,
+                           const MatchResult* result = nullptr) = 0;
+    virtual void logInfo(const QString& message) = 0;
+    virtual void logError(const QString& message) = 0;
+    virtual void logSuccess(const QString& message) = 0;
+    virtual QString resolveImagePath(const QString& imageNameOrPath) const = 0;
+    // 所属窗口的条件运行统计；返回 nullptr 时使用进程共享的一份
+    virtual ConditionStatsRegistry* conditionStats() { return nullptr; }
+};
+
+// 顶层任务的上下文；调度线程恢复协程前设为当前上下文，DSL 函数据此找到所属窗口
+struct TaskContext {
+    IAsyncToolbox* toolbox = nullptr;
+    std::coroutine_handle<> root;   // 顶层外壳（spawn 设置）；取消时由调度器销毁，连带销毁它等待的子任务
+};
+
+inline TaskContext*& currentContext() {
+    thread_local TaskContext* ctx = nullptr;
+    return ctx;
+}
+
+inline IAsyncToolbox* toolbox() {
+    TaskContext* ctx = currentContext();
+    return ctx ? ctx->toolbox : nullptr;
+}
+
+// =============== 调度器 ===============
+// 少量线程共享一个就绪队列和一个定时队列；协程挂起时不占用任何线程。
+// 窗口销毁时用 cancel 取消自己的任务；进程退出前显式 shutdown，不在静态对象析构时才停线程
+class Scheduler {
+public:
+    static Scheduler& instance() {
+        static Scheduler s;
+        return s;
+    }
+
+    // 调度器是否已创建（退出时据此决定要不要 shutdown，避免为了关闭而先启动线程）
+    static bool created() { return created_.load(); }
+
+    ~Scheduler() { shutdown(); }
+
+    // 顶层任务开始运行；由 spawn 调用。已 shutdown 时直接销毁
+    void start(TaskContext* ctx) {
+        {
+            QMutexLocker lock(&mutex_);
+            if (!stopping_) {
+                live_.push_back(ctx);
+                ready_.push_back({ctx->root, ctx});
+                ctx = nullptr;
+            }
+        }
+        if (ctx) { ctx->root.destroy(); return; }
+        wake_.wakeOne();
+    }
+
+    // 顶层任务正常结束（在调度线程上、调用 done 之前）；之后 cancel 不再处理它
+    void finished(TaskContext* ctx) {
+        QMutexLocker lock(&mutex_);
+        live_.erase(std::remove(live_.begin(), live_.end(), ctx), live_.end());
+    }
+
+    // 放入就绪队列，由任一调度线程恢复。deliver 在锁内、任务仍存活时执行，用于把异步结果写进等待体：
+    // 任务已取消（帧已销毁或即将销毁）时既不写入也不排队
+    void post(std::coroutine_handle<> h, TaskContext* ctx, const std::function<void()>& deliver = nullptr) {
+        {
+            QMutexLocker lock(&mutex_);
+            if (!accepts(ctx)) return;
+            if (deliver) deliver();
+            ready_.push_back({h, ctx});
+        }
+        wake_.wakeOne();
+    }
+
+    // ms 毫秒后放入就绪队列
+    void postAfter(int ms, std::coroutine_handle<> h, TaskContext* ctx) {
+        {
+            QMutexLocker lock(&mutex_);
+            if (!accepts(ctx)) return;
+            timers_.push({clock_.elapsed() + qMax(0, ms), seq_++, {h, ctx}});
+        }
+        wake_.wakeOne();
+    }
+
+    // 取消一个顶层任务：丢弃它排队的恢复并销毁协程帧，done 不会被调用。
+    // 不能在调度线程上调用；任务正在某个调度线程上运行时等它挂起
+    void cancel(TaskContext* ctx) {
+        std::coroutine_handle<> root;
+        {
+            QMutexLocker lock(&mutex_);
+            while (std::find(running_.begin(), running_.end(), ctx) != running_.end()) idle_.wait(&mutex_);
+            auto it = std::find(live_.begin(), live_.end(), ctx);
+            if (it == live_.end()) return;  // 已结束或已取消
+            live_.erase(it);
+            ready_.erase(std::remove_if(ready_.begin(), ready_.end(),
+                                        [ctx](const Item& i) { return i.ctx == ctx; }), ready_.end());
+            std::vector<Timer> keep;
+            while (!timers_.empty()) {
+                if (timers_.top().item.ctx != ctx) keep.push_back(timers_.top());
+                timers_.pop();
+            }
+            for (const Timer& t : keep) timers_.push(t);
+            root = ctx->root;
+        }
+        root.destroy();
+    }
+
+    // 停止调度：丢弃全部排队的恢复，等调度线程退出，再销毁所有未结束的任务。可重复调用
+    void shutdown() {
+        std::vector<QThread*> threads;
+        std::vector<std::coroutine_handle<>> roots;
+        {
+            QMutexLocker lock(&mutex_);
+            stopping_ = true;
+            ready_.clear();
+            while (!timers_.empty()) timers_.pop();
+            for (TaskContext* ctx : live_) roots.push_back(ctx->root);
+            live_.clear();
+            threads.swap(threads_);
+        }
+        wake_.wakeAll();
+        for (QThread* t : threads) {
+            t->wait();
+            delete t;
+        }
+        for (auto h : roots) h.destroy();
+    }
+
+    int threadCount() {
+        QMutexLocker lock(&mutex_);
+        return static_cast<int>(threads_.size());
+    }
+
+private:
+    struct Item {
+        std::coroutine_handle<> handle;
+        TaskContext* ctx;
+    };
+    struct Timer {
+        qint64 due;
+        quint64 seq;    // 同一时刻到期时先到先出
+        Item item;
+        bool operator>(const Timer& o) const { return due != o.due ? due > o.due : seq > o.seq; }
+    };
+
+    Scheduler() {
+        created_ = true;
+        clock_.start();
+        // 协程大部分时间在等截图/定时器，匹配才占 CPU：2~4 个线程足够
+        const int n = qBound(2, QThread::idealThreadCount() / 2, 4);
+        for (int i = 0; i < n; ++i) {
+            QThread* t = QThread::create([this]() { loop(); });
+            t->setObjectName(QString("imgdsl-co-%1").arg(i));
+            t->start();
+            threads_.push_back(t);
+        }
+    }
+
+    void loop() {
+        QMutexLocker lock(&mutex_);
+        while (!stopping_) {
+            const qint64 now = clock_.elapsed();
+            while (!timers_.empty() && timers_.top().due <= now) {
+                ready_.push_back(timers_.top().item);
+                timers_.pop();
+            }
+            if (!ready_.empty()) {
+                const Item item = ready_.front();
+                ready_.pop_front();
+                running_.push_back(item.ctx);
+                lock.unlock();
+                currentContext() = item.ctx;
+                stats_override() = item.ctx && item.ctx->toolbox ? item.ctx->toolbox->conditionStats() : nullptr;
+                item.handle.resume();
+                currentContext() = nullptr;
+                stats_override() = nullptr;
+                lock.relock();
+                running_.erase(std::find(running_.begin(), running_.end(), item.ctx));
+                idle_.wakeAll();
+                continue;
+            }
+            if (timers_.empty()) {
+                wake_.wait(&mutex_);
+            } else {
+                wake_.wait(&mutex_, static_cast<unsigned long>(timers_.top().due - now));
+            }
+        }
+    }
+
+    // 没有上下文的恢复照常排队；有上下文的只接受仍在运行的任务
+    bool accepts(TaskContext* ctx) const {
+        return !stopping_ && (!ctx || std::find(live_.begin(), live_.end(), ctx) != live_.end());
+    }
+
+    static inline std::atomic<bool> created_{false};
+    QMutex mutex_;
+    QWaitCondition wake_;
+    QWaitCondition idle_;                   // 有任务从调度线程上挂起（cancel 等待用）
+    std::vector<TaskContext*> live_;        // 未结束的顶层任务
+    std::vector<TaskContext*> running_;     // 正在调度线程上运行的任务
+    std::deque<Item> ready_;
+    std::priority_queue<Timer, std::vector<Timer>, std::greater<Timer>> timers_;
+    QElapsedTimer clock_;
+    quint64 seq_ = 0;
+    bool stopping_ = false;
+    std::vector<QThread*> threads_;
+};
+
+// =============== Task<T> ===============
+// 惰性启动：被 co_await 时才开始执行，结束后直接切回等待者（对称转移，不增长调用栈）
+namespace detail {
+
+struct PromiseBase {
+    std::coroutine_handle<> continuation;
+    std::exception_ptr error;
+
+    struct FinalAwaiter {
+        std::coroutine_handle<> next;
+        bool await_ready() const noexcept { return false; }
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<>) const noexcept {
+            return next ? next : std::noop_coroutine();
+        }
+        void await_resume() const noexcept {}
+    };
+
+    std::suspend_always initial_suspend() const noexcept { return {}; }
+    FinalAwaiter final_suspend() const noexcept { return {continuation}; }
+    void unhandled_exception() { error = std::current_exception(); }
+    void rethrow() const { if (error) std::rethrow_exception(error); }
+};
+
+template <typename T>
+struct Promise : PromiseBase {
+    std::optional<T> value;
+    void return_value(T v) { value = std::move(v); }
+    T result() { rethrow(); return std::move(*value); }
+};
+
+template <>
+struct Promise<void> : PromiseBase {
+    void return_void() {}
+    void result() { rethrow(); }
+};
+
+} // namespace detail
+
+template <typename T = void>
+class [[nodiscard]] Task {
+public:
+    struct promise_type : detail::Promise<T> {
+        Task get_return_object() { return Task(std::coroutine_handle<promise_type>::from_promise(*this)); }
+    };
+
+    Task(Task&& o) noexcept : h_(std::exchange(o.h_, {})) {}
+    Task& operator=(Task&& o) noexcept {
+        if (this != &o) {
+            if (h_) h_.destroy();
+            h_ = std::exchange(o.h_, {});
+        }
+        return *this;
+    }
+    Task(const Task&) = delete;
+    Task& operator=(const Task&) = delete;
+    ~Task() { if (h_) h_.destroy(); }
+
+    bool await_ready() const noexcept { return !h_ || h_.done(); }
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> caller) noexcept {
+        h_.promise().continuation = caller;
+        return h_;
+    }
+    T await_resume() { return h_.promise().result(); }
+
+private:
+    explicit Task(std::coroutine_handle<promise_type> h) : h_(h) {}
+    std::coroutine_handle<promise_type> h_;
+};
+
+namespace detail {
+
+// 顶层任务的外壳：结束时自行销毁
+struct Detached {
+    struct promise_type {
+        Detached get_return_object() { return {std::coroutine_handle<promise_type>::from_promise(*this)}; }
+        std::suspend_always initial_suspend() const noexcept { return {}; }
+        std::suspend_never final_suspend() const noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() {}
+    };
+    std::coroutine_handle<promise_type> handle;
+};
+
+inline Detached runDetached(Task<bool> task, TaskContext* ctx, std::function<void(bool ok)> done) {
+    bool ok = false;
+    try {
+        ok = co_await std::move(task);
+    } catch (const std::exception& e) {
+        qWarning() << "[imgdsl::co] task failed:" << e.what();
+    } catch (...) {
+        qWarning() << "[imgdsl::co] task failed";
+    }
+    Scheduler::instance().finished(ctx);
+    if (done) done(ok);
+}
+
+} // namespace detail
+
+// 在调度器上启动顶层任务；ctx 不能为空，须存活到 done 被调用或任务被取消（Scheduler::cancel）
+inline void spawn(Task<bool> task, TaskContext* ctx, std::function<void(bool ok)> done = nullptr) {
+    auto d = detail::runDetached(std::move(task), ctx, std::move(done));
+    ctx->root = d.handle;
+    Scheduler::instance().start(ctx);
+}
+
+// =============== 等待体 ===============
+struct SleepAwaiter {
+    int ms;
+    bool await_ready() const noexcept { return ms <= 0; }
+    void await_suspend(std::coroutine_handle<> h) const {
+        Scheduler::instance().postAfter(ms, h, currentContext());
+    }
+    void await_resume() const noexcept {}
+};
+
+// 截取下一帧；结果留在工具接口里供 matchBatch 使用
+struct FrameAwaiter {
+    bool ok = false;
+    bool await_ready() const noexcept { return false; }
+    void await_suspend(std::coroutine_handle<> h) {
+        TaskContext* ctx = currentContext();
+        if (!ctx || !ctx->toolbox) { Scheduler::instance().post(h, ctx); return; }
+        // 回调可能在 await_suspend 返回前就恢复协程：之后不再访问任何成员
+        ctx->toolbox->requestFrame([this, h, ctx](bool got) {
+            Scheduler::instance().post(h, ctx, [this, got]() { ok = got; });
+        });
+    }
+    bool await_resume() const noexcept { return ok; }
+};
+
+struct ClickAwaiter {
+    QPoint pt;
+    bool ok = false;
+    bool await_ready() const noexcept { return false; }
+    void await_suspend(std::coroutine_handle<> h) {
+        TaskContext* ctx = currentContext();
+        if (!ctx || !ctx->toolbox) { Scheduler::instance().post(h, ctx); return; }
+        ctx->toolbox->requestClick(pt, [this, h, ctx](bool done) {
+            Scheduler::instance().post(h, ctx, [this, done]() { ok = done; });
+        });
+    }
+    bool await_resume() const noexcept { return ok; }
+};
+
+// =============== DSL ===============
+// 条件类型与组合子沿用阻塞版；协程任务里 using namespace imgdsl::co 即可
+using imgdsl::Condition;
+using imgdsl::MatchResult;
+using imgdsl::MatchPlan;
+using imgdsl::Selected;
+using imgdsl::ANY;
+using imgdsl::ALL;
+
+inline Condition IMG(const QString& imageNameOrPath, double th = 0.85,
+                     QRect roi = QRect(), bool multiScale = true) {
+    IAsyncToolbox* tb = toolbox();
+    return Condition::APPEAR(tb ? tb->resolveImagePath(imageNameOrPath) : imageNameOrPath, th, roi, multiScale);
+}
+
+inline SleepAwaiter SLEEP(int ms) { return {ms}; }
+
+inline FrameAwaiter nextFrame() { return {}; }
+
+// 在 nextFrame 截取的帧上批量匹配计划的全部叶子，并逐叶子记入条件统计
+inline std::vector<MatchResult> matchLeaves(IAsyncToolbox* tb, const MatchPlan& plan) {
+    std::vector<MatchResult> hits = tb->matchBatch(plan.leaves());
+    hits.resize(plan.leaves().size());
+    condition_stats().recordLeaves(plan.leaves(), hits);
+    return hits;
+}
+
+// Opaque 子条件会在调度线程上阻塞截图、访问其他窗口的全局工具接口：直接拒绝
+inline bool rejectOpaque(IAsyncToolbox* tb, const MatchPlan& plan) {
+    const QStringList opaque = plan.opaqueNames();
+    if (opaque.isEmpty()) return false;
+    tb->logError(QString("协程任务不支持 FAMILY / STABILIZED / 自定义条件：%1").arg(opaque.join(", ")));
+    return true;
+}
+
+// 以下为函数对象而不是函数：参数是 imgdsl::Condition，普通函数会经 ADL 与阻塞版同名函数冲突
+struct WaitUntilFn {
+    Task<bool> operator()(Condition c, int timeoutMs = 8000, int intervalMs = 200,
+                          MatchResult* out = nullptr) const {
+        IAsyncToolbox* tb = toolbox();
+        if (!tb) { qWarning() << "[imgdsl::co] no task context"; co_return false; }
+        tb->logAction("WAIT_UNTIL", c.name(), timeoutMs);
+        const MatchPlan plan(c);
+        if (rejectOpaque(tb, plan)) co_return false;
+        QElapsedTimer timer;
+        timer.start();
+        while (timer.elapsed() <= timeoutMs && !tb->cancelled()) {
+            if (co_await nextFrame()) {
+                MatchResult r;
+                if (c.eval(plan, matchLeaves(tb, plan), &r)) {
+                    if (out) *out = r;
+                    co_return true;
+                }
+            }
+            co_await SLEEP(intervalMs);
+        }
+        co_return false;
+    }
+};
+
+struct SelectFn {
+    Task<Selected> operator()(std::vector<Condition> branches, int timeoutMs = 8000, int intervalMs = 200) const {
+        Selected sel;
+        IAsyncToolbox* tb = toolbox();
+        if (!tb) { qWarning() << "[imgdsl::co] no task context"; co_return sel; }
+        QStringList names;
+        for (const auto& b : branches) names << b.name();
+        tb->logAction("WAIT_UNTIL", QString("SELECT(%1)").arg(names.join(" | ")), timeoutMs);
+        const MatchPlan plan(branches);
+        if (rejectOpaque(tb, plan)) co_return sel;
+        QElapsedTimer timer;
+        timer.start();
+        while (timer.elapsed() <= timeoutMs && !tb->cancelled()) {
+            if (co_await nextFrame()) {
+                sel.index = plan.select(matchLeaves(tb, plan), &sel.result);
+                if (sel.index >= 0) {
+                    sel.label = names[sel.index];
+                    co_return sel;
+                }
+            }
+            co_await SLEEP(intervalMs);
+        }
+        sel.result = {};
+        co_return sel;
+    }
+};
+
+struct ClickFn {
+    Task<bool> operator()(Condition c) const {
+        co_return co_await click(c.name(), c.last());
+    }
+    Task<bool> operator()(Selected s) const {
+        if (s.index < 0) co_return false;
+        co_return co_await click(s.label, s.result);
+    }
+
+private:
+    static Task<bool> click(QString name, MatchResult hit) {
+        IAsyncToolbox* tb = toolbox();
+        if (!tb || !hit.matched || tb->cancelled()) co_return false;
+        tb->logAction("CLICK", name, -1, &hit);
+        co_return co_await ClickAwaiter{hit.point};
+    }
+};
+
+// 点击并等画面稳定：co_await CLICK_SETTLE(btn, 1500) 代替 co_await CLICK(btn); co_await SLEEP(1500);
+// 与阻塞版 clickAndSettle 相同：先等点击点附近开始变化，再等它连续几帧不变；附近一直没有变化时等满上限
+struct ClickSettleFn {
+    Task<bool> operator()(Condition c, int maxWaitMs = 1500) const {
+        co_return co_await clickSettle(c.name(), c.last(), maxWaitMs);
+    }
+    Task<bool> operator()(Selected s, int maxWaitMs = 1500) const {
+        if (s.index < 0) co_return false;
+        co_return co_await clickSettle(s.label, s.result, maxWaitMs);
+    }
+
+private:
+    static constexpr int kPollMs = 40;      // 截图间隔
+    static constexpr int kRadius = 100;     // 观察点击点周围 ±100 逻辑像素
+    static constexpr int kFrames = 3;       // 连续 3 帧不变视为已稳定
+
+    static Task<bool> clickSettle(QString name, MatchResult hit, int maxWaitMs) {
+        IAsyncToolbox* tb = toolbox();
+        if (!tb || !hit.matched || tb->cancelled()) co_return false;
+        tb->logAction("CLICK", name, -1, &hit);
+        // 点击前的画面作为比较基准
+        bool haveBefore = false;
+        if (maxWaitMs > 0) haveBefore = co_await nextFrame();
+        if (haveBefore) tb->markFrame();
+        if (!co_await ClickAwaiter{hit.point}) co_return false;
+        if (maxWaitMs <= 0) co_return true;
+
+        QElapsedTimer timer;
+        timer.start();
+        // 1) 等点击点附近的画面开始变化（游戏响应了这次点击）
+        bool changed = false;
+        while (haveBefore && !changed && timer.elapsed() < maxWaitMs && !tb->cancelled()) {
+            co_await SLEEP(kPollMs);
+            if (!co_await nextFrame()) break;
+            changed = tb->regionChanged(hit.point, kRadius);
+        }
+        // 2) 再等它连续几帧不变（与前一帧比较）
+        bool settled = false;
+        if (changed) {
+            tb->markFrame();
+            int same = 1;
+            while (same < kFrames && timer.elapsed() < maxWaitMs && !tb->cancelled()) {
+                co_await SLEEP(kPollMs);
+                if (!co_await nextFrame()) break;
+                same = tb->regionChanged(hit.point, kRadius) ? 1 : same + 1;
+                tb->markFrame();
+            }
+            settled = same >= kFrames;
+        }
+        // 附近一直没有变化或到上限仍在变化：无法判断，按原固定时长等满
+        if (!settled && !tb->cancelled()) co_await SLEEP(maxWaitMs - static_cast<int>(timer.elapsed()));
+        tb->recordSettle(static_cast<int>(timer.elapsed()), settled, maxWaitMs);
+        co_return true;
+    }
+};
+
+inline constexpr WaitUntilFn WAIT_UNTIL{};
+inline constexpr SelectFn SELECT{};
+inline constexpr ClickFn CLICK{};
+inline constexpr ClickSettleFn CLICK_SETTLE{};
+
+} // namespace imgdsl::co
+
+#endif // __cpp_impl_coroutine
+#endif // IMGDSL_CO_H
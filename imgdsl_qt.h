@@ -8,9 +8,13 @@
 #include <QDebug>
 #include <QElapsedTimer>
 #include <QThread>
+#include <QHash>
+#include <QMutex>
 #include <vector>
 #include <memory>
 #include <functional>
+#include <algorithm>
+#include <atomic>
 #include <QStringList>
 
 namespace imgdsl {
@@ -20,14 +24,114 @@ struct MatchResult {
     QPoint point;
     double score{0.0};
     QString which;
+    QString path;           // 命中模板的路径（叶子 / 变体族）；NOT 与自定义条件为空
+    double costMs{0.0};     // 批量匹配时该叶子的耗时，记入条件统计
 };
 
+// 多目标结果的排序方式
+enum class SortBy {
+    Position,   // 从上到下、从左到右
+    Score       // 得分从高到低
+};
+
+// 单模板匹配请求（APPEAR 叶子）；MatchPlan 按它去重，相同请求一帧只匹配一次
+struct LeafQuery {
+    QString path;
+    double th{0.85};
+    QRect roi;
+    bool multiScale{true};
+
+    LeafQuery() = default;
+    LeafQuery(QString p, double t, QRect r, bool ms)
+        : path(std::move(p)), th(t), roi(r), multiScale(ms),
+          key_(QString("%1|%2|%3,%4,%5,%6|%7").arg(path).arg(th)
+                   .arg(roi.x()).arg(roi.y()).arg(roi.width()).arg(roi.height()).arg(multiScale ? 1 : 0)) {}
+
+    bool operator==(const LeafQuery& o) const {
+        return path == o.path && th == o.th && roi == o.roi && multiScale == o.multiScale;
+    }
+
+    // 与 operator== 一致的字符串标识，用作条件统计的键；构造时拼好，求值时不再生成字符串
+    const QString& key() const { return key_; }
+
+private:
+    QString key_;
+};
+
+class ConditionStatsRegistry;
+
 // =============== 工具接口（需由上层实现并注入） ===============
 struct IToolbox {
     virtual ~IToolbox() = default;
     virtual MatchResult findImage(const QString& path, double th,
                                   const QRect& roi, bool multiScale) = 0;
+    // 批量：同一帧上匹配 queries（每个取最佳匹配），结果与 queries 一一对应；默认逐个 findImage
+    virtual std::vector<MatchResult> findBatch(const std::vector<LeafQuery>& queries) {
+        std::vector<MatchResult> out;
+        out.reserve(queries.size());
+        for (const auto& q : queries) {
+            QElapsedTimer timer;
+            timer.start();
+            MatchResult r = findImage(q.path, q.th, q.roi, q.multiScale);
+            if (r.which.isEmpty()) r.which = q.path;
+            r.costMs = timer.nsecsElapsed() / 1e6;
+            out.push_back(r);
+        }
+        return out;
+    }
+    // 等待命中区域稳定：从命中那一帧起，hit 所在区域连续 frames 帧像素不变返回 true，超时返回 false；
+    // hit.path 为空（NOT、自定义条件，没有命中位置）时看整帧；
+    // changed 返回期间区域是否变化过（变化过则命中位置需要重新确认）。
+    // 默认实现没有帧流，只能按固定间隔等待并要求调用方重新匹配
+    virtual bool waitStable(const MatchResult& hit, int frames, int timeoutMs, bool* changed) {
+        Q_UNUSED(hit)
+        Q_UNUSED(timeoutMs)
+        for (int i = 1; i < frames; ++i) sleepMs(150);
+        if (changed) *changed = true;
+        return true;
+    }
+    // 颜色变体模板族：返回命中的变体（which）；默认逐个变体匹配
+    virtual MatchResult findFamily(const QStringList& paths, double th, const QRect& roi) {
+        for (const auto& p : paths) {
+            MatchResult r = findImage(p, th, roi, false);
+            if (r.matched) { r.which = p; return r; }
+        }
+        return {};
+    }
+    // 多目标：一帧内找出 paths 的所有实例（去重叠后最多 maxCount 个）；默认只返回各模板的最佳匹配
+    virtual std::vector<MatchResult> findAll(const QStringList& paths, double th, const QRect& roi,
+                                             int maxCount, SortBy sortBy) {
+        Q_UNUSED(sortBy)
+        std::vector<MatchResult> out;
+        for (const auto& p : paths) {
+            if (maxCount > 0 && static_cast<int>(out.size()) >= maxCount) break;
+            MatchResult r = findImage(p, th, roi, false);
+            if (r.matched) { r.which = p; out.push_back(r); }
+        }
+        return out;
+    }
+    // 一帧检测 paths（每个取最佳匹配）后按顺序逐个点击，间隔 delayMs；
+    // verify 时检查点击点附近画面是否变化。返回有效点击数。默认逐个匹配并点击
+    virtual int clickEach(const QStringList& paths, double th, const QRect& roi,
+                          int delayMs, bool verify) {
+        Q_UNUSED(verify)
+        int n = 0;
+        for (const auto& p : paths) {
+            MatchResult r = findImage(p, th, roi, false);
+            if (r.matched && clickLogical(r.point)) {
+                ++n;
+                if (delayMs > 0) sleepMs(delayMs);
+            }
+        }
+        return n;
+    }
     virtual bool clickLogical(const QPoint& logicalPt) = 0;
+    // 点击后等画面稳定（先变化、再静止），maxWaitMs 为上限；默认固定等待 maxWaitMs
+    virtual bool clickAndSettle(const QPoint& logicalPt, int maxWaitMs) {
+        if (!clickLogical(logicalPt)) return false;
+        if (maxWaitMs > 0) sleepMs(maxWaitMs);
+        return true;
+    }
     virtual void sleepMs(int ms) = 0;
     virtual void logAction(const QString& action, const QString& conditionName, int timeout = -1, const imgdsl::MatchResult* result = nullptr) = 0;
     virtual void logInfo(const QString& message) = 0;
@@ -38,6 +142,9 @@ struct IToolbox {
     virtual void setTaskContext(const QString& taskName) = 0;
     virtual void clearTaskContext() = 0;
     virtual QString resolveImagePath(const QString& imageNameOrPath) const = 0;
+
+    // 本窗口的条件运行统计；返回 nullptr 时使用进程共享的一份
+    virtual ConditionStatsRegistry* conditionStats() { return nullptr; }
 };
 
 inline IToolbox*& toolbox() {
@@ -47,68 +154,227 @@ inline IToolbox*& toolbox() {
 
 inline void set_toolbox(IToolbox* t) { toolbox() = t; }
 
+// =============== 条件运行统计与求值顺序 ===============
+// 每个条件的平均耗时与命中率，用于给 ANY / ALL 的子条件排序。
+// APPEAR 叶子按 路径|阈值|ROI 统计（与 MatchPlan 的叶子去重一致，同一模板不同 ROI 分开记），其余条件按名称。
+// 统计按窗口分开（见 condition_stats）；未开启自适应顺序时不记录，求值不付出统计开销
+struct ConditionStats {
+    double meanCostMs = 0.0;
+    double hitRate = 0.5;
+    int samples = 0;
+};
+
+class ConditionStatsRegistry {
+public:
+    static ConditionStatsRegistry& instance() {
+        static ConditionStatsRegistry r;
+        return r;
+    }
+
+    void record(const QString& key, double costMs, bool hit) {
+        if (key.isEmpty() || !adaptive()) return;
+        QMutexLocker lock(&mutex_);
+        ConditionStats& s = stats_[key];
+        // 前 kWindow 次取算术平均，之后按指数滑动平均跟随画面变化
+        const double a = 1.0 / std::min(s.samples + 1, kWindow);
+        s.meanCostMs += a * (costMs - s.meanCostMs);
+        s.hitRate += a * ((hit ? 1.0 : 0.0) - s.hitRate);
+        ++s.samples;
+    }
+
+    ConditionStats get(const QString& key) {
+        QMutexLocker lock(&mutex_);
+        return stats_.value(key);
+    }
+
+    // 一次批量匹配的结果（与 leaves 一一对应）逐叶子记入
+    void recordLeaves(const std::vector<LeafQuery>& leaves, const std::vector<MatchResult>& hits) {
+        if (!adaptive()) return;
+        const size_t n = std::min(leaves.size(), hits.size());
+        for (size_t i = 0; i < n; ++i) record(leaves[i].key(), hits[i].costMs, hits[i].matched);
+    }
+
+    // 求值顺序：默认为声明顺序；开启自适应后按运行统计排序——
+    // ANY 先试“命中率/耗时”最高的子条件，ALL 先试“失败率/耗时”最高的（最早短路）。
+    // 没有统计的子条件按命中率 0.5 估计；得分相同时保持声明顺序。keyAt(i) 返回第 i 个子条件的统计键
+    template <typename KeyAt>
+    std::vector<size_t> order(size_t count, bool forAny, KeyAt keyAt) {
+        std::vector<size_t> result(count);
+        for (size_t i = 0; i < count; ++i) result[i] = i;
+        if (!adaptive() || count < 2) return result;
+
+        std::vector<double> score(count);
+        for (size_t i = 0; i < count; ++i) {
+            const ConditionStats s = get(keyAt(i));
+            const double p = forAny ? s.hitRate : 1.0 - s.hitRate;
+            score[i] = p / std::max(s.meanCostMs, 0.01);
+        }
+        std::stable_sort(result.begin(), result.end(),
+                         [&](size_t a, size_t b) { return score[a] > score[b]; });
+        return result;
+    }
+
+    void clear() {
+        QMutexLocker lock(&mutex_);
+        stats_.clear();
+    }
+
+    // 自适应顺序：默认关闭，ANY / ALL 严格按声明顺序求值（行为可预测）
+    void setAdaptive(bool on) { adaptive_ = on; }
+    bool adaptive() const { return adaptive_; }
+
+private:
+    static constexpr int kWindow = 32;
+    QMutex mutex_;
+    QHash<QString, ConditionStats> stats_;
+    std::atomic<bool> adaptive_{false};
+};
+
+// 协程调度线程上恢复某个任务前设为该任务的统计（工具接口不是 IToolbox，无法经 toolbox() 找到）
+inline ConditionStatsRegistry*& stats_override() {
+    thread_local ConditionStatsRegistry* stats = nullptr;
+    return stats;
+}
+
+// 当前求值所用的条件统计：协程任务的 > 当前工具接口（窗口）的 > 进程共享的
+inline ConditionStatsRegistry& condition_stats() {
+    if (ConditionStatsRegistry* s = stats_override()) return *s;
+    if (IToolbox* tb = toolbox()) {
+        if (ConditionStatsRegistry* s = tb->conditionStats()) return *s;
+    }
+    return ConditionStatsRegistry::instance();
+}
+
+inline void set_adaptive_order(bool on) { condition_stats().setAdaptive(on); }
+
+class MatchPlan;
+
 // =============== 条件抽象 ===============
 class Condition {
 public:
     using EvalFn = std::function<MatchResult()>;
+    // 条件树结构，供 MatchPlan 展开；Opaque 只能整体求值（自定义函数、FAMILY、STABILIZED）
+    enum class Kind { Opaque, Leaf, Not, Any, All };
+
     Condition() = default;
     explicit Condition(EvalFn fn, QString name = {})
         : eval_(std::move(fn)), name_(std::move(name)) {}
 
     bool eval(MatchResult* out = nullptr) const {
+        QElapsedTimer timer;
+        timer.start();
         MatchResult r = eval_ ? eval_() : MatchResult{};
-        last_ = r;
-        if (out) *out = r;
-        return r.matched;
+        return finish(r, timer, out);
     }
 
+    // 按预先编译好的计划求值（plan 须由本条件构造）：全部叶子一帧批量匹配
+    bool eval(const MatchPlan& plan, MatchResult* out = nullptr) const;
+    // 同上，叶子结果已由调用方匹配好
+    bool eval(const MatchPlan& plan, const std::vector<MatchResult>& hits, MatchResult* out) const;
+
     operator bool() const { return eval(); }
 
     const MatchResult& last() const { return last_; }
 
-    bool click() const {
+    // settleMaxMs > 0 时点击后等画面稳定，最多等 settleMaxMs
+    bool click(int settleMaxMs = 0) const {
         if (!toolbox()) { qWarning() << "[imgdsl] toolbox not set"; return false; }
         if (!last_.matched) return false;
         if (toolbox()) toolbox()->logAction("CLICK", name(), -1, &last_);
+        if (settleMaxMs > 0) return toolbox()->clickAndSettle(last_.point, settleMaxMs);
         return toolbox()->clickLogical(last_.point);
     }
 
     QString name() const { return name_; }
 
+    // 运行统计的键：叶子为 LeafQuery::key()，其余为名称
+    const QString& statsKey() const { return kind_ == Kind::Leaf ? leaf_.key() : name_; }
+
+    Kind kind() const { return kind_; }
+    const LeafQuery& leaf() const { return leaf_; }
+    const std::vector<Condition>& children() const {
+        static const std::vector<Condition> none;
+        return children_ ? *children_ : none;
+    }
+
 private:
+    using Children = std::shared_ptr<const std::vector<Condition>>;
+
+    bool finish(const MatchResult& r, const QElapsedTimer& timer, MatchResult* out) const {
+        ConditionStatsRegistry& stats = condition_stats();
+        if (stats.adaptive()) stats.record(statsKey(), timer.nsecsElapsed() / 1e6, r.matched);
+        last_ = r;
+        if (out) *out = r;
+        return r.matched;
+    }
+
+    // 组合条件：子条件列表由求值函数与结构信息共享，复制条件不再复制整棵子树
+    static Condition composite(Kind kind, Children children, EvalFn fn, QString name) {
+        Condition c(std::move(fn), std::move(name));
+        c.kind_ = kind;
+        c.children_ = std::move(children);
+        return c;
+    }
+
     EvalFn eval_{};
     mutable MatchResult last_{};
     QString name_{};
+    Kind kind_{Kind::Opaque};
+    LeafQuery leaf_{};
+    Children children_{};
 
 public:
     static Condition APPEAR(QString path, double th = 0.85,
                             QRect roi = QRect(), bool multiScale = true) {
-        return Condition([=]() -> MatchResult {
+        Condition c([=]() -> MatchResult {
             if (!toolbox()) { qWarning() << "[imgdsl] toolbox not set"; return {}; }
             auto r = toolbox()->findImage(path, th, roi, multiScale);
             if (r.matched && r.which.isEmpty()) r.which = path;
+            if (r.matched) r.path = path;
             return r;
         }, QString("APPEAR(%1)").arg(path));
+        c.kind_ = Kind::Leaf;
+        c.leaf_ = LeafQuery{path, th, roi, multiScale};
+        return c;
     }
 
-    static Condition NOT(Condition c) {
+    // 颜色变体族：一次形状匹配找到任一变体，which 为命中的变体路径
+    static Condition FAMILY(QStringList paths, double th = 0.85, QRect roi = QRect()) {
         return Condition([=]() -> MatchResult {
+            if (!toolbox()) { qWarning() << "[imgdsl] toolbox not set"; return {}; }
+            MatchResult r = toolbox()->findFamily(paths, th, roi);
+            if (r.matched) r.path = r.which;
+            return r;
+        }, QString("FAMILY(%1)").arg(paths.join(", ")));
+    }
+
+    static Condition NOT(Condition c) {
+        const QString name = QString("NOT(%1)").arg(c.name());
+        Children kids = std::make_shared<std::vector<Condition>>(1, c);
+        return composite(Kind::Not, kids, [kids, name]() -> MatchResult {
             MatchResult inner;
-            bool ok = c.eval(&inner);
+            bool ok = kids->front().eval(&inner);
             MatchResult out;
             out.matched = !ok;
-            out.which = QString("NOT(%1)").arg(c.name());
+            out.which = name;
             return out;
-        }, QString("NOT(%1)").arg(c.name()));
+        }, name);
+    }
+
+    // 子条件的求值顺序，见 ConditionStatsRegistry::order
+    static std::vector<size_t> evalOrder(const std::vector<Condition>& conds, bool forAny) {
+        return condition_stats().order(
+            conds.size(), forAny, [&](size_t i) { return conds[i].statsKey(); });
     }
 
     static Condition ANY(std::vector<Condition> conds) {
         QStringList names;
         for (const auto& c : conds) { names << c.name(); }
-        return Condition([=]() -> MatchResult {
-            for (const auto& c : conds) {
+        Children kids = std::make_shared<std::vector<Condition>>(std::move(conds));
+        return composite(Kind::Any, kids, [kids]() -> MatchResult {
+            for (size_t i : evalOrder(*kids, true)) {
                 MatchResult r;
-                if (c.eval(&r)) return r;
+                if ((*kids)[i].eval(&r)) return r;
             }
             return {};
         }, QString("ANY(%1)").arg(names.join(" | ")));
@@ -117,31 +383,201 @@ public:
     static Condition ALL(std::vector<Condition> conds) {
         QStringList names;
         for (const auto& c : conds) { names << c.name(); }
-        return Condition([=]() -> MatchResult {
-            MatchResult first;
-            bool firstFilled = false;
-            for (const auto& c : conds) {
-                MatchResult r;
-                if (!c.eval(&r)) return {};
-                if (!firstFilled) { first = r; firstFilled = true; }
+        Children kids = std::make_shared<std::vector<Condition>>(std::move(conds));
+        return composite(Kind::All, kids, [kids]() -> MatchResult {
+            // 无论求值顺序如何，返回声明顺序中第一个子条件的结果
+            std::vector<MatchResult> results(kids->size());
+            for (size_t i : evalOrder(*kids, false)) {
+                if (!(*kids)[i].eval(&results[i])) return {};
             }
-            return first;
+            return results.empty() ? MatchResult{} : results.front();
         }, QString("ALL(%1)").arg(names.join(" & ")));
     }
 
-    static Condition STABILIZED(Condition c, int n = 2, int intervalMs = 150) {
+    // 稳定：c 成立后，命中区域在帧序列中连续 frames 帧不变才算成立。
+    // 命中后只做区域帧差，画面一静止立即返回；期间区域变化过（动画、滑入）时按最终画面重新匹配一次确认位置。
+    // timeoutMs 内始终没有静止视为不成立
+    static Condition STABILIZED(Condition c, int frames = 3, int timeoutMs = 1500) {
         return Condition([=]() -> MatchResult {
             if (!toolbox()) return {};
-            MatchResult last;
-            for (int i = 0; i < n; ++i) {
-                if (!c.eval(&last)) return {};
-                if (i < n - 1) toolbox()->sleepMs(intervalMs);
+            MatchResult r;
+            if (!c.eval(&r)) return {};
+            bool changed = false;
+            if (!toolbox()->waitStable(r, frames, timeoutMs, &changed)) return {};
+            if (changed && !c.eval(&r)) return {};
+            return r;
+        }, QString("STABILIZED(%1,x%2)").arg(c.name()).arg(frames));
+    }
+};
+
+// =============== 匹配计划 ===============
+// 把条件树展开为：去重后的叶子列表（模板、ROI、阈值都相同的 APPEAR 只匹配一次）+ 布尔结构。
+// 每次 run 先在同一帧上批量匹配全部叶子（逐叶子记入条件统计），再按结构求值：ANY / ALL 的子条件
+// 顺序与逐个求值相同（Condition::evalOrder），ALL 取声明顺序中第一个子条件的结果。
+// 无法展开的 Opaque 子条件仍各自求值
+class MatchPlan {
+public:
+    explicit MatchPlan(const Condition& root) { roots_.push_back(add(root)); }
+
+    // 多个分支共用一份叶子列表（SELECT）
+    explicit MatchPlan(const std::vector<Condition>& branches) {
+        for (const auto& b : branches) roots_.push_back(add(b));
+    }
+
+    const std::vector<LeafQuery>& leaves() const { return leaves_; }
+
+    // 至少两个不同叶子时批量才有收益；单叶子或纯 Opaque 的条件直接 eval 即可
+    bool worthwhile() const { return leaves_.size() >= 2; }
+
+    // 含 Opaque 子条件的名称（FAMILY、STABILIZED、自定义函数）；这些只能经阻塞版工具接口整体求值
+    QStringList opaqueNames() const {
+        QStringList names;
+        for (const Node& n : nodes_) {
+            if (n.kind == Condition::Kind::Opaque) names << n.name;
+        }
+        return names;
+    }
+
+    MatchResult run() const {
+        if (!toolbox()) { qWarning() << "[imgdsl] toolbox not set"; return {}; }
+        return evaluate(matchLeaves());
+    }
+
+    // 一次批量匹配后按声明顺序找第一个成立的分支，返回其下标；都不成立返回 -1
+    int select(MatchResult* out = nullptr) const {
+        if (!toolbox()) { qWarning() << "[imgdsl] toolbox not set"; return -1; }
+        return select(matchLeaves(), out);
+    }
+
+    // 叶子结果由调用方提供（与 leaves() 一一对应），例如协程版在自己截取的帧上匹配
+    MatchResult evaluate(const std::vector<MatchResult>& hits) const {
+        if (roots_.empty() || hits.size() != leaves_.size()) return {};
+        return evalNode(roots_.front(), hits);
+    }
+
+    // 只求第 branch 个分支
+    MatchResult evaluate(size_t branch, const std::vector<MatchResult>& hits) const {
+        if (branch >= roots_.size() || hits.size() != leaves_.size()) return {};
+        return evalNode(roots_[branch], hits);
+    }
+
+    int select(const std::vector<MatchResult>& hits, MatchResult* out) const {
+        if (hits.size() != leaves_.size()) return -1;
+        for (size_t i = 0; i < roots_.size(); ++i) {
+            MatchResult r = evalNode(roots_[i], hits);
+            if (r.matched) {
+                if (out) *out = r;
+                return static_cast<int>(i);
             }
-            return last;
-        }, QString("STABILIZED(%1,x%2)").arg(c.name()).arg(n));
+        }
+        return -1;
     }
+
+private:
+    std::vector<MatchResult> matchLeaves() const {
+        std::vector<MatchResult> hits;
+        if (!leaves_.empty()) hits = toolbox()->findBatch(leaves_);
+        hits.resize(leaves_.size());
+        condition_stats().recordLeaves(leaves_, hits);
+        return hits;
+    }
+
+    struct Node {
+        Condition::Kind kind{Condition::Kind::Opaque};
+        int leaf{-1};               // Leaf：leaves_ 下标
+        std::vector<int> children;  // Not / Any / All：nodes_ 下标
+        Condition opaque;           // Opaque：原条件
+        QString name;
+        QString statsKey;
+    };
+
+    // Any / All 节点子条件的求值顺序
+    std::vector<size_t> childOrder(const Node& n) const {
+        return condition_stats().order(
+            n.children.size(), n.kind == Condition::Kind::Any,
+            [&](size_t i) { return nodes_[static_cast<size_t>(n.children[i])].statsKey; });
+    }
+
+    int add(const Condition& c) {
+        Node n;
+        n.kind = c.kind();
+        n.name = c.name();
+        n.statsKey = c.statsKey();
+        switch (c.kind()) {
+        case Condition::Kind::Leaf: {
+            auto it = std::find(leaves_.begin(), leaves_.end(), c.leaf());
+            n.leaf = static_cast<int>(it - leaves_.begin());
+            if (it == leaves_.end()) leaves_.push_back(c.leaf());
+            break;
+        }
+        case Condition::Kind::Not:
+        case Condition::Kind::Any:
+        case Condition::Kind::All:
+            for (const auto& child : c.children()) n.children.push_back(add(child));
+            break;
+        case Condition::Kind::Opaque:
+            n.opaque = c;
+            break;
+        }
+        nodes_.push_back(std::move(n));
+        return static_cast<int>(nodes_.size()) - 1;
+    }
+
+    MatchResult evalNode(int index, const std::vector<MatchResult>& hits) const {
+        const Node& n = nodes_[static_cast<size_t>(index)];
+        switch (n.kind) {
+        case Condition::Kind::Leaf: {
+            MatchResult r = hits[static_cast<size_t>(n.leaf)];
+            if (r.matched && r.which.isEmpty()) r.which = leaves_[static_cast<size_t>(n.leaf)].path;
+            if (r.matched) r.path = leaves_[static_cast<size_t>(n.leaf)].path;
+            return r;
+        }
+        case Condition::Kind::Not: {
+            MatchResult out;
+            out.matched = n.children.empty() || !evalNode(n.children.front(), hits).matched;
+            out.which = n.name;
+            return out;
+        }
+        case Condition::Kind::Any:
+            for (size_t i : childOrder(n)) {
+                MatchResult r = evalNode(n.children[i], hits);
+                if (r.matched) return r;
+            }
+            return {};
+        case Condition::Kind::All: {
+            MatchResult first;
+            for (size_t i : childOrder(n)) {
+                MatchResult r = evalNode(n.children[i], hits);
+                if (!r.matched) return {};
+                if (i == 0) first = r;
+            }
+            return first;
+        }
+        case Condition::Kind::Opaque:
+            break;
+        }
+        MatchResult r;
+        n.opaque.eval(&r);
+        return r;
+    }
+
+    std::vector<Node> nodes_;
+    std::vector<LeafQuery> leaves_;
+    std::vector<int> roots_;
 };
 
+inline bool Condition::eval(const MatchPlan& plan, MatchResult* out) const {
+    QElapsedTimer timer;
+    timer.start();
+    return finish(plan.run(), timer, out);
+}
+
+inline bool Condition::eval(const MatchPlan& plan, const std::vector<MatchResult>& hits, MatchResult* out) const {
+    QElapsedTimer timer;
+    timer.start();
+    return finish(plan.evaluate(hits), timer, out);
+}
+
 // 【优化点】IMG 函数现在会自动解析路径
 inline Condition IMG(const QString& imageNameOrPath, double th = 0.85,
                      QRect roi = QRect(), bool multiScale = true) {
@@ -153,6 +589,42 @@ inline Condition IMG(const QString& imageNameOrPath, double th = 0.85,
     return Condition::APPEAR(fullPath, th, roi, multiScale);
 }
 
+// 颜色变体族：FAMILY({"绿色帜", "蓝色帜", "紫色帜"})，名称同 IMG 一样自动解析
+inline Condition FAMILY(const QStringList& variants, double th = 0.85, QRect roi = QRect()) {
+    QStringList paths;
+    for (const auto& v : variants) {
+        paths << (toolbox() ? toolbox()->resolveImagePath(v) : v);
+    }
+    return Condition::FAMILY(paths, th, roi);
+}
+
+// 多目标：FIND_ALL("宝箱") / FIND_ALL({"7天", "14天"})，一次截图返回全部命中（名称同 IMG 一样自动解析）
+inline std::vector<MatchResult> FIND_ALL(const QStringList& imageNamesOrPaths, double th = 0.85,
+                                         int maxCount = 16, SortBy sortBy = SortBy::Position,
+                                         QRect roi = QRect()) {
+    if (!toolbox()) { qWarning() << "[imgdsl] toolbox not set"; return {}; }
+    QStringList paths;
+    for (const auto& n : imageNamesOrPaths) paths << toolbox()->resolveImagePath(n);
+    auto hits = toolbox()->findAll(paths, th, roi, maxCount, sortBy);
+    toolbox()->logInfo(QString("FIND_ALL(%1) -> %2").arg(paths.join(", ")).arg(hits.size()));
+    return hits;
+}
+
+inline std::vector<MatchResult> FIND_ALL(const QString& imageNameOrPath, double th = 0.85,
+                                         int maxCount = 16, SortBy sortBy = SortBy::Position,
+                                         QRect roi = QRect()) {
+    return FIND_ALL(QStringList{imageNameOrPath}, th, maxCount, sortBy, roi);
+}
+
+// 逐个点击：EACH({"7天", "14天", "21天", "28天"}, 0.85, 300)，一次截图检测全部，再依次点击命中项
+inline int EACH(const QStringList& imageNamesOrPaths, double th = 0.85, int delayMs = 300,
+                bool verify = false, QRect roi = QRect()) {
+    if (!toolbox()) { qWarning() << "[imgdsl] toolbox not set"; return 0; }
+    QStringList paths;
+    for (const auto& n : imageNamesOrPaths) paths << toolbox()->resolveImagePath(n);
+    return toolbox()->clickEach(paths, th, roi, delayMs, verify);
+}
+
 // 逻辑运算（与/或/非）
 inline Condition operator||(const Condition& a, const Condition& b) {
     return Condition::ANY({a, b});
@@ -173,17 +645,117 @@ inline bool WAIT_UNTIL(const Condition& c, int timeoutMs = 8000, int intervalMs
                        MatchResult* out = nullptr) {
     if (!toolbox()) { qWarning() << "[imgdsl] toolbox not set"; return false; }
     toolbox()->logAction("WAIT_UNTIL", c.name(), timeoutMs);
+    // 组合条件只编译一次：每轮一帧批量匹配全部叶子
+    const MatchPlan plan(c);
+    const bool batched = plan.worthwhile();
     QElapsedTimer timer; timer.start();
     while (timer.elapsed() <= timeoutMs) {
         MatchResult r;
-        if (c.eval(&r)) { if (out) *out = r; return true; }
+        if (batched ? c.eval(plan, &r) : c.eval(&r)) { if (out) *out = r; return true; }
         toolbox()->sleepMs(intervalMs);
     }
     return false;
 }
 
+// 多分支等待的结果：index 为成立的分支下标（声明顺序），超时为 -1
+struct Selected {
+    int index{-1};
+    MatchResult result;
+    QString label;      // 成立分支的条件名
+
+    explicit operator bool() const { return index >= 0; }
+
+    bool click(int settleMaxMs = 0) const {
+        if (!toolbox()) { qWarning() << "[imgdsl] toolbox not set"; return false; }
+        if (index < 0 || !result.matched) return false;
+        toolbox()->logAction("CLICK", label, -1, &result);
+        if (settleMaxMs > 0) return toolbox()->clickAndSettle(result.point, settleMaxMs);
+        return toolbox()->clickLogical(result.point);
+    }
+};
+
+// 同时等待多个分支，任一成立即返回是哪一个：
+//   auto sel = SELECT({canContinue, buyBtn}, 10000);
+//   if (sel.index == 1) { ... }
+// 每轮一帧批量匹配全部分支的叶子（相同模板只匹配一次），同一轮多个分支成立时取靠前的
+inline Selected SELECT(const std::vector<Condition>& branches, int timeoutMs = 8000, int intervalMs = 200) {
+    Selected sel;
+    if (!toolbox()) { qWarning() << "[imgdsl] toolbox not set"; return sel; }
+    QStringList names;
+    for (const auto& b : branches) names << b.name();
+    toolbox()->logAction("WAIT_UNTIL", QString("SELECT(%1)").arg(names.join(" | ")), timeoutMs);
+    const MatchPlan plan(branches);
+    QElapsedTimer timer; timer.start();
+    while (timer.elapsed() <= timeoutMs) {
+        sel.index = plan.select(&sel.result);
+        if (sel.index >= 0) {
+            sel.label = names[sel.index];
+            return sel;
+        }
+        toolbox()->sleepMs(intervalMs);
+    }
+    sel.result = {};
+    return sel;
+}
+
+// =============== 共享帧 ===============
+// 一个 tick 里要看的条件（主流程守卫、弹窗/断线/每日重置等监视者）先用 watch 登记，
+// capture() 截一次图批量匹配全部叶子，之后 test() 只在这一帧的结果上求值，不再截图：
+//   SharedFrame frame;
+//   const int popup = frame.watch(IMG("关闭窗口"));
+//   machine.setFrameSource([&](fsm::Context*) { frame.capture(); });
+//   if (auto s = frame.test(popup)) s.click();
+// 与 MatchPlan 相同，Opaque 条件仍各自求值
+class SharedFrame {
+public:
+    int watch(const Condition& c) {
+        conds_.push_back(c);
+        plan_.reset();
+        hits_.clear();
+        return static_cast<int>(conds_.size()) - 1;
+    }
+
+    void capture() {
+        if (!plan_) plan_ = std::make_unique<MatchPlan>(conds_);
+        hits_.clear();
+        if (!toolbox()) { qWarning() << "[imgdsl] toolbox not set"; }
+        else if (!plan_->leaves().empty()) hits_ = toolbox()->findBatch(plan_->leaves());
+        hits_.resize(plan_->leaves().size());
+        condition_stats().recordLeaves(plan_->leaves(), hits_);
+        ++sequence_;
+    }
+
+    // 第 id 个登记条件在本帧是否成立；未 capture 过视为不成立
+    Selected test(int id) const {
+        Selected sel;
+        if (!plan_ || id < 0 || id >= static_cast<int>(conds_.size())) return sel;
+        MatchResult r = plan_->evaluate(static_cast<size_t>(id), hits_);
+        if (!r.matched) return sel;
+        sel.index = id;
+        sel.result = r;
+        sel.label = conds_[static_cast<size_t>(id)].name();
+        return sel;
+    }
+
+    // 已截取的帧数，用来判断两次检查是否看的是同一帧
+    quint64 sequence() const { return sequence_; }
+
+private:
+    std::vector<Condition> conds_;
+    std::unique_ptr<MatchPlan> plan_;
+    std::vector<MatchResult> hits_;
+    quint64 sequence_ = 0;
+};
+
 inline bool CLICK(const Condition& c) { return c.click(); }
 
+inline bool CLICK(const Selected& s) { return s.click(); }
+
+// 点击并等画面稳定：CLICK_SETTLE(btn, 1500) 代替 CLICK(btn); SLEEP(1500);
+// 画面一静止就返回，1500 只是上限
+inline bool CLICK_SETTLE(const Condition& c, int maxWaitMs = 1500) { return c.click(maxWaitMs); }
+inline bool CLICK_SETTLE(const Selected& s, int maxWaitMs = 1500) { return s.click(maxWaitMs); }
+
 inline bool CLICK_AT(const QPoint& pt) {
     if (!toolbox()) return false;
     return toolbox()->clickLogical(pt);
@@ -5,6 +5,7 @@
 #include <QDebug>
 #include "mainwindow.h"
 #include "taskmodel.h"
+#include "imgdsl_co.h"
 
 int main(int argc, char *argv[])
 {
@@ -60,5 +61,10 @@ int main(int argc, char *argv[])
 
     MainWindow w;
     w.show();
-    return app.exec();
+    const int rc = app.exec();
+#ifdef IMGDSL_HAS_COROUTINES
+    // 退出前显式停止协程调度线程并销毁未结束的任务，不留到静态对象析构时
+    if (imgdsl::co::Scheduler::created()) imgdsl::co::Scheduler::instance().shutdown();
+#endif
+    return rc;
 }
@@ -212,67 +212,7 @@ void MainWindow::ensureThreadAndWorker(GameWindowCtx& ctx) {
         ctx.worker = new AutomationWorker(ctx.view, ctx.stop, nullptr); // 父设 nullptr 才能 moveToThread
         ctx.worker->moveToThread(ctx.thread);
 
-        // 日志转发
-        connect(ctx.worker, &AutomationWorker::log, this, [wlog = QPointer<QTextEdit>(ctx.log)](const QString& s){
-            if (wlog) wlog->append(QString("[%1] %2")
-                                 .arg(QTime::currentTime().toString("HH:mm:ss"), s));
-        });
-
-        connect(ctx.worker, &AutomationWorker::logThumb, this,
-                [log = QPointer<QTextEdit>(ctx.log)](const QString& action, const QStringList& paths, double thr, int ms, double scale){
-                    if (!log || paths.isEmpty()) return;
-
-                    const QString timestamp = QTime::currentTime().toString("HH:mm:ss");
-                    QString html = QString("<div>[%1] [步骤] %2：").arg(timestamp, action);
-
-                    for (int i = 0; i < paths.size(); ++i) {
-                        const QString& path = paths[i];
-                        const QString base = QFileInfo(path).fileName();
-
-                        QImage img;
-                        if (img.load(path)) {
-                            // --- 核心修改点：从 addResource 改为 Base64 编码 ---
-                            const int maxW = 48;
-                            int w = img.width(), h = img.height();
-                            if (w > maxW) {
-                                h = int(h * (double(maxW) / w));
-                                w = maxW;
-                            }
-                            QImage thumb = img.scaled(w, h, Qt::KeepAspectRatio, Qt::SmoothTransformation);
-
-                            // 1. 将缩略图保存到内存中的 QByteArray
-                            QByteArray ba;
-                            QBuffer buffer(&ba);
-                            buffer.open(QIODevice::WriteOnly);
-                            thumb.save(&buffer, "PNG"); // 指定格式为 PNG
-
-                            // 2. 将 QByteArray 转换为 Base64 编码的字符串
-                            QString base64_data = QString::fromLatin1(ba.toBase64());
-
-                            // 3. 构建一个自包含的 <img> 标签
-                            html.append(QString(" %1 <img src=\"data:image/png;base64,%2\" style=\"vertical-align:middle;margin-left:2px;\">")
-                                            .arg(base, base64_data));
-
-                        } else {
-                            html.append(" " + base + "[加载失败]");
-                        }
-
-                        if (i < paths.size() - 1) {
-                            html.append(" |");
-                        }
-                    }
-
-                    html.append(QString(" (阈值=%1, 超时=%2ms)</div>").arg(thr,0,'f',2).arg(ms));
-
-                    log->append(html);
-                });
-
-        connect(ctx.worker, &AutomationWorker::finished, this, [wlog = QPointer<QTextEdit>(ctx.log)](const QString& plan){
-            if (wlog) wlog->append(QStringLiteral("%1 执行完毕").arg(plan));
-        });
-        connect(ctx.worker, &AutomationWorker::aborted, this, [wlog = QPointer<QTextEdit>(ctx.log)](const QString& reason){
-            if (wlog) wlog->append(QStringLiteral("[中断] %1").arg(reason));
-        });
+        connectWorkerLogs(ctx);
 
         // 任务结束 → 线程退出；线程退出 → 释放 worker；更新 ctx 状态
         connect(ctx.worker, &AutomationWorker::finished, ctx.thread, &QThread::quit);
@@ -294,6 +234,90 @@ void MainWindow::ensureThreadAndWorker(GameWindowCtx& ctx) {
 
     if (!ctx.thread->isRunning()) ctx.thread->start();
 }
+void MainWindow::connectWorkerLogs(GameWindowCtx& ctx) {
+    // 日志转发
+    connect(ctx.worker, &AutomationWorker::log, this, [wlog = QPointer<QTextEdit>(ctx.log)](const QString& s){
+        if (wlog) wlog->append(QString("[%1] %2")
+                             .arg(QTime::currentTime().toString("HH:mm:ss"), s));
+    });
+
+    connect(ctx.worker, &AutomationWorker::logThumb, this,
+            [log = QPointer<QTextEdit>(ctx.log)](const QString& action, const QStringList& paths, double thr, int ms, double scale){
+                if (!log || paths.isEmpty()) return;
+
+                const QString timestamp = QTime::currentTime().toString("HH:mm:ss");
+                QString html = QString("<div>[%1] [步骤] %2：").arg(timestamp, action);
+
+                for (int i = 0; i < paths.size(); ++i) {
+                    const QString& path = paths[i];
+                    const QString base = QFileInfo(path).fileName();
+
+                    QImage img;
+                    if (img.load(path)) {
+                        // --- 核心修改点：从 addResource 改为 Base64 编码 ---
+                        const int maxW = 48;
+                        int w = img.width(), h = img.height();
+                        if (w > maxW) {
+                            h = int(h * (double(maxW) / w));
+                            w = maxW;
+                        }
+                        QImage thumb = img.scaled(w, h, Qt::KeepAspectRatio, Qt::SmoothTransformation);
+
+                        // 1. 将缩略图保存到内存中的 QByteArray
+                        QByteArray ba;
+                        QBuffer buffer(&ba);
+                        buffer.open(QIODevice::WriteOnly);
+                        thumb.save(&buffer, "PNG"); // 指定格式为 PNG
+
+                        // 2. 将 QByteArray 转换为 Base64 编码的字符串
+                        QString base64_data = QString::fromLatin1(ba.toBase64());
+
+                        // 3. 构建一个自包含的 <img> 标签
+                        html.append(QString(" %1 <img src=\"data:image/png;base64,%2\" style=\"vertical-align:middle;margin-left:2px;\">")
+                                        .arg(base, base64_data));
+
+                    } else {
+                        html.append(" " + base + "[加载失败]");
+                    }
+
+                    if (i < paths.size() - 1) {
+                        html.append(" |");
+                    }
+                }
+
+                html.append(QString(" (阈值=%1, 超时=%2ms)</div>").arg(thr,0,'f',2).arg(ms));
+
+                log->append(html);
+            });
+
+    connect(ctx.worker, &AutomationWorker::finished, this, [wlog = QPointer<QTextEdit>(ctx.log)](const QString& plan){
+        if (wlog) wlog->append(QStringLiteral("%1 执行完毕").arg(plan));
+    });
+    connect(ctx.worker, &AutomationWorker::aborted, this, [wlog = QPointer<QTextEdit>(ctx.log)](const QString& reason){
+        if (wlog) wlog->append(QStringLiteral("[中断] %1").arg(reason));
+    });
+}
+void MainWindow::ensureCoroutineWorker(GameWindowCtx& ctx) {
+    if (!ctx.stop) ctx.stop = QSharedPointer<StopToken>::create();
+    if (ctx.worker) return;
+
+    // 协程版任务：worker 留在 GUI 线程，任务在共享调度线程上运行，不为该窗口创建线程
+    ctx.worker = new AutomationWorker(ctx.view, ctx.stop, nullptr);
+    connectWorkerLogs(ctx);
+
+    auto cleanup = [this, worker = ctx.worker, pView = QPointer<QWebEngineView>(ctx.view)]() {
+        worker->deleteLater();
+        if (!pView) return;
+        if (auto c = ctxFor(pView)) {
+            if (c->worker == worker) c->worker = nullptr;
+            c->active = false;
+            c->lastActive = QDateTime::currentDateTime();
+            if (c->log) c->log->append(QStringLiteral("[自动化] 已停止并清理。"));
+        }
+    };
+    connect(ctx.worker, &AutomationWorker::finished, this, cleanup);
+    connect(ctx.worker, &AutomationWorker::aborted, this, cleanup);
+}
 void MainWindow::teardownThreadAndWorker(GameWindowCtx& ctx) {
     if (ctx.thread) {
         // 不 terminate；quit 等自然退出
@@ -364,6 +388,15 @@ void MainWindow::startAutomationFor(QWebEngineView *view, QTextEdit *log, const
     if (!ctx->stop) ctx->stop = QSharedPointer<StopToken>::create();
     ctx->stop->cancelled.store(false, std::memory_order_relaxed);
 
+    // 有协程版的任务不占用独立线程
+    if (!ctx->thread && AutomationWorker::hasCoroutineTask(planName)) {
+        ensureCoroutineWorker(*ctx);
+        ctx->active = true;
+        ctx->lastActive = QDateTime::currentDateTime();
+        ctx->worker->startCoroutineTask(planName);
+        return;
+    }
+
     ensureThreadAndWorker(*ctx);
     ctx->active = true;
     ctx->lastActive = QDateTime::currentDateTime();
@@ -376,12 +409,12 @@ void MainWindow::startAutomationFor(QWebEngineView *view, QTextEdit *log, const
 void MainWindow::stopAutomationFor(QWebEngineView *view, QTextEdit *log)
 {
     auto ctx = ctxFor(view);
-    if (!ctx || !ctx->thread || !ctx->worker) {
+    if (!ctx || !ctx->worker) {
         if (log) log->append(QStringLiteral("[提示] 当前没有正在运行的任务。"));
         return;
     }
     if (ctx->stop) ctx->stop->cancelled.store(true, std::memory_order_relaxed);
-    ctx->thread->quit();
+    if (ctx->thread) ctx->thread->quit();   // 协程版任务没有线程，检查到停止标志后自行结束
     if (log) log->append(QStringLiteral("[自动化] 已请求停止"));
 }
 
@@ -99,6 +99,8 @@ private:
     GameWindowCtx& ensureCtx(QWebEngineView* v); // 若无则创建空 ctx（仅存 view）
     void ensureThreadAndWorker(GameWindowCtx& ctx);     // 按需创建/连接/启动
     void teardownThreadAndWorker(GameWindowCtx& ctx);   // 回收线程/worker
+    void ensureCoroutineWorker(GameWindowCtx& ctx);     // 协程版任务：只建 worker，不建线程
+    void connectWorkerLogs(GameWindowCtx& ctx);         // worker 日志/结束信号 -> 日志框
     void removeTabIfAny(GameWindowCtx& ctx);
 };
 
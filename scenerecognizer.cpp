@@ -0,0 +1,133 @@
+#include "scenerecognizer.h"
+
+#include <QDir>
+#include <QFileInfo>
+#include <QDebug>
+#include <QCoreApplication>
+#include <opencv2/imgproc.hpp>
+#include <opencv2/imgcodecs.hpp>
+#include <algorithm>
+
+namespace vision {
+
+static const int kMaxRefsPerScene = 32;  // 每个场景最多保留的参考帧
+static const int kDuplicateDistance = 4; // 与已有参考相差不超过该值视为重复，不再加入
+static const int kConfidentDistance = 12;// 最近参考的汉明距离上限（256 位）
+static const int kConfidentMargin = 24;  // 最近场景需比次近场景至少近这么多
+
+SceneRecognizer& SceneRecognizer::instance() {
+    static SceneRecognizer recognizer;
+    return recognizer;
+}
+
+void SceneRecognizer::ensureLoaded() {
+    {
+        QMutexLocker lock(&mutex_);
+        if (loaded_) return;
+        loaded_ = true;
+    }
+    const QString appDir = QCoreApplication::applicationDirPath();
+    int n = loadReferences(appDir + "/游戏图片/场景参考");
+    if (n == 0) n = loadReferences("游戏图片/场景参考");
+    if (n > 0) qDebug() << "[SceneRecognizer] loaded references:" << n;
+}
+
+int SceneRecognizer::loadReferences(const QString& dir) {
+    QDir root(dir);
+    if (!root.exists()) return 0;
+
+    int count = 0;
+    for (const QString& scene : root.entryList(QDir::Dirs | QDir::NoDotAndDotDot)) {
+        QDir sceneDir(root.filePath(scene));
+        for (const QString& file : sceneDir.entryList(QStringList() << "*.png", QDir::Files)) {
+            cv::Mat gray = imreadSafe(sceneDir.filePath(file), cv::IMREAD_GRAYSCALE);
+            if (gray.empty()) continue;
+            addReference(scene, SceneHash::compute(gray));
+            ++count;
+        }
+    }
+    return count;
+}
+
+void SceneRecognizer::addReference(const QString& scene, const SceneHash& hash) {
+    if (scene.isEmpty() || !hash.valid) return;
+
+    QMutexLocker lock(&mutex_);
+    QList<SceneHash>& refs = references_[scene];
+    for (const auto& r : refs) {
+        if (r.distance(hash) <= kDuplicateDistance) return;
+    }
+    if (refs.size() >= kMaxRefsPerScene) refs.removeFirst();
+    refs.append(hash);
+}
+
+bool SceneRecognizer::hasScene(const QString& scene) {
+    ensureLoaded();
+    QMutexLocker lock(&mutex_);
+    return references_.contains(scene);
+}
+
+SceneRecognizer::Result SceneRecognizer::recognize(const Frame& frame) {
+    Result result;
+    if (frame.empty()) return result;
+    ensureLoaded();
+
+    const SceneHash& hash = frame.sceneHash();
+
+    QMutexLocker lock(&mutex_);
+    int best = 257;
+    int second = 257;
+    for (auto it = references_.constBegin(); it != references_.constEnd(); ++it) {
+        int d = 257;
+        for (const auto& r : it.value()) d = std::min(d, r.distance(hash));
+        if (d < best) {
+            second = best;
+            best = d;
+            result.scene = it.key();
+        } else if (d < second) {
+            second = d;
+        }
+    }
+    if (result.scene.isEmpty()) return result;
+
+    result.distance = best;
+    // 只有一个场景有参考时 second 无意义，“明显近于其他场景”无从谈起
+    result.confident = references_.size() >= 2 && best <= kConfidentDistance &&
+                       second - best >= kConfidentMargin;
+    return result;
+}
+
+QString SceneRecognizer::sceneForTemplate(const QString& templatePath) {
+    static const QString kTitleSuffix = QStringLiteral("标题");
+    const QString base = QFileInfo(templatePath).completeBaseName();
+    if (!base.endsWith(kTitleSuffix) || base.size() == kTitleSuffix.size()) return QString();
+    return base.left(base.size() - kTitleSuffix.size());
+}
+
+static QString titleKey(const cv::Size& frameSize, const QString& templatePath) {
+    return QString("%1x%2|%3").arg(frameSize.width).arg(frameSize.height).arg(templatePath);
+}
+
+bool SceneRecognizer::cachedTitle(const void* owner, const cv::Size& frameSize, const QString& templatePath,
+                                  Hit* out) {
+    QMutexLocker lock(&mutex_);
+    auto window = titles_.constFind(owner);
+    if (window == titles_.constEnd()) return false;
+    auto it = window.value().constFind(titleKey(frameSize, templatePath));
+    if (it == window.value().constEnd()) return false;
+    if (out) *out = it.value();
+    return true;
+}
+
+void SceneRecognizer::rememberTitle(const void* owner, const cv::Size& frameSize, const QString& templatePath,
+                                    const Hit& hit) {
+    QMutexLocker lock(&mutex_);
+    titles_[owner].insert(titleKey(frameSize, templatePath), hit);
+}
+
+void SceneRecognizer::forgetTitles(const void* owner) {
+    QMutexLocker lock(&mutex_);
+    titles_.remove(owner);
+}
+
+} // namespace vision
@@ -0,0 +1,60 @@
+#ifndef SCENERECOGNIZER_H
+#define SCENERECOGNIZER_H
+
+#include "templatematcher.h"
+
+#include <QString>
+#include <QStringList>
+#include <QHash>
+#include <QList>
+#include <QMutex>
+
+namespace vision {
+
+// 场景识别器（进程内共享，线程安全）
+// 以整帧感知哈希对照已标注的参考帧，快速回答“当前在哪个界面”。
+// 参考帧来源：
+//   1. 游戏图片/场景参考/<场景名>/*.png（录制的截图）
+//   2. 运行中标题模板（xxx标题.png）高分匹配成功时的帧，自动记为场景 xxx 的参考
+// 至少两个场景有参考、最近参考足够近且明显近于其他场景时才给出确定结论，否则交给完整模板匹配
+class SceneRecognizer {
+public:
+    struct Result {
+        QString scene;          // 最近的场景（无参考时为空）
+        int distance = -1;      // 与该场景最近参考的汉明距离（0-256）
+        bool confident = false; // 是否可以据此跳过完整匹配
+    };
+
+    static SceneRecognizer& instance();
+
+    Result recognize(const Frame& frame);
+
+    void addReference(const QString& scene, const SceneHash& hash);
+    bool hasScene(const QString& scene);
+
+    // 从目录加载参考帧：每个子目录为一个场景；返回加载的帧数
+    int loadReferences(const QString& dir);
+
+    // 标题模板与场景的对应：xxx标题.png → 场景 xxx；其他模板返回空
+    static QString sceneForTemplate(const QString& templatePath);
+
+    // 标题模板最近一次的命中，按窗口（owner）与帧尺寸分开记录；
+    // 调用方确认处于该场景后只在这个位置附近小范围复核，不再整帧匹配
+    bool cachedTitle(const void* owner, const cv::Size& frameSize, const QString& templatePath, Hit* out);
+    void rememberTitle(const void* owner, const cv::Size& frameSize, const QString& templatePath, const Hit& hit);
+    // 窗口关闭时丢弃它的标题命中
+    void forgetTitles(const void* owner);
+
+private:
+    SceneRecognizer() = default;
+    void ensureLoaded();
+
+    QMutex mutex_;
+    bool loaded_ = false;
+    QHash<QString, QList<SceneHash>> references_;
+    QHash<const void*, QHash<QString, Hit>> titles_;   // owner -> "宽x高|模板路径" -> 命中
+};
+
+} // namespace vision
+
+#endif // SCENERECOGNIZER_H
@@ -1,5 +1,6 @@
 #include "scriptrunner.h"
 #include "automationworker.h"
+#include "templatematcher.h"
 #include <QElapsedTimer>
 #include <QThread>
 #include <QDebug>
@@ -7,6 +8,8 @@
 #include <QCoreApplication>
 #include <QFileInfo>
 #include <QFile>
+#include <QSet>
+#include <QHash>
 
 ScriptRunner::ScriptRunner(AutomationWorker* worker, QObject* parent)
     : QObject(parent), worker_(worker)
@@ -22,6 +25,8 @@ void ScriptRunner::stop() {
 }
 
 bool ScriptRunner::shouldStop() const {
+    // 中断规则要求跳转/失败时，当前步骤与其子步骤也按停止处理
+    if (!interruptNext_.isEmpty()) return true;
     return stopped_.load() || (worker_ && worker_->shouldStop("ScriptRunner"));
 }
 
@@ -40,10 +45,20 @@ bool ScriptRunner::execute(const TaskDefinition& task) {
         return false;
     }
 
+    // resume 为 goto 的中断规则目标不存在时，跑到一半才发现跳不过去：开始前拒绝
+    const QString problem = task.checkInterrupts();
+    if (!problem.isEmpty()) {
+        emit log(QStringLiteral("[脚本] %1").arg(problem));
+        emit taskFinished(false, problem);
+        return false;
+    }
+
     currentTask_ = task;
     stopped_.store(false);
     running_.store(true);
     stepIndex_.clear();
+    interruptCounts_.fill(0, task.interrupts.size());
+    interruptNext_.clear();
 
     // 构建步骤ID索引
     for (int i = 0; i < task.steps.size(); ++i) {
@@ -54,6 +69,24 @@ bool ScriptRunner::execute(const TaskDefinition& task) {
 
     emit log(QStringLiteral("[脚本] 开始执行任务: %1").arg(task.name));
 
+    // 第一步之前预加载、编译全部引用的模板，缺失的图片在这里一次报告
+    QStringList referenced;
+    for (const auto& img : task.getReferencedImages()) referenced << resolveImagePath(img);
+    QElapsedTimer prefetchTimer;
+    prefetchTimer.start();
+    const QStringList missing = vision::TemplateRegistry::instance().prefetch(referenced);
+    missingImages_ = QSet<QString>(missing.begin(), missing.end());
+    emit log(QStringLiteral("[脚本] 预加载 %1 张图片，用时 %2 ms").arg(referenced.size() - missing.size())
+                 .arg(prefetchTimer.elapsed()));
+    for (const auto& path : missing) {
+        emit log(QStringLiteral("[脚本] 图片文件不存在: %1").arg(path));
+    }
+    buildInterruptTargets();
+    if (!task.interrupts.isEmpty()) {
+        emit log(QStringLiteral("[脚本] 中断规则 %1 条，共 %2 个模板").arg(task.interrupts.size())
+                     .arg(interruptTargets_.size()));
+    }
+
     int currentIndex = 0;
     bool success = true;
     QString lastResult;
@@ -72,6 +105,12 @@ bool ScriptRunner::execute(const TaskDefinition& task) {
 
         QString nextStepId = executeStep(step);
         bool stepSuccess = !nextStepId.startsWith("__FAIL__");
+        if (!interruptNext_.isEmpty()) {
+            // 中断规则接管下一步
+            nextStepId = interruptNext_;
+            interruptNext_.clear();
+            stepSuccess = false;
+        }
 
         emit stepCompleted(step.id, stepSuccess);
 
@@ -149,6 +188,16 @@ QString ScriptRunner::executeStep(const TaskStep& step) {
         case StepType::LoopUntil:
             success = executeLoopUntil(step);
             break;
+        case StepType::FindAll: {
+            QString jumpTo;
+            success = executeFindAll(step, &jumpTo);
+            // 子步骤要求跳转或结束任务：由 execute 处理
+            if (!jumpTo.isEmpty()) return jumpTo;
+            break;
+        }
+        case StepType::ClickAll:
+            success = executeClickAll(step);
+            break;
         case StepType::Goto:
             return step.onSuccess;
         case StepType::EndSuccess:
@@ -160,6 +209,10 @@ QString ScriptRunner::executeStep(const TaskStep& step) {
     if (success) {
         return step.onSuccess.isEmpty() ? "__NEXT__" : step.onSuccess;
     } else {
+        if (!interruptNext_.isEmpty()) {
+            // 被中断规则中止，下一步由 execute 决定
+            return "__NEXT__";
+        }
         if (!step.onFail.isEmpty()) {
             // 用户指定了失败时的跳转
             return step.onFail;
@@ -188,15 +241,12 @@ bool ScriptRunner::executeWaitClick(const TaskStep& step) {
             pos += step.clickOffset;
             lastMatchedPos_ = pos;
 
-            if (clickAtPoint(pos)) {
-                if (step.sleepMs > 0) {
-                    sleepMs(step.sleepMs);
-                }
+            if (clickAndSettle(pos, step.sleepMs)) {
                 return true;
             } else {
                 emit log(QStringLiteral("[脚本] 点击失败，位置: (%1, %2)").arg(pos.x()).arg(pos.y()));
             }
-        } else {
+        } else if (!shouldStop()) {
             emit log(QStringLiteral("[脚本] 等待图片超时: %1").arg(step.images.join(", ")));
         }
     }
@@ -221,7 +271,7 @@ bool ScriptRunner::executeWaitAppear(const TaskStep& step) {
         if (waitForImage(step.images, step.threshold, step.timeout, step.matchMode, &pos)) {
             lastMatchedPos_ = pos;
             return true;
-        } else {
+        } else if (!shouldStop()) {
             emit log(QStringLiteral("[脚本] 等待图片超时: %1").arg(step.images.join(", ")));
         }
     }
@@ -237,17 +287,17 @@ bool ScriptRunner::executeWaitDisappear(const TaskStep& step) {
     while (timer.elapsed() < step.timeout) {
         if (shouldStop()) return false;
 
-        bool exists = false;
-        for (const auto& img : step.images) {
-            if (checkImageExists(img, step.threshold)) {
-                exists = true;
-                break;
-            }
-        }
+        auto frame = captureFrame();
+        const bool exists = checkAnyImageExists(step.images, step.threshold, nullptr, frame.get());
 
         if (!exists) {
             return true;
         }
+        if (handleInterrupts(frame.get())) {
+            if (shouldStop()) return false;
+            timer.restart();
+            continue;
+        }
 
         sleepMs(200);
     }
@@ -276,28 +326,22 @@ bool ScriptRunner::executeSleep(const TaskStep& step) {
 
 bool ScriptRunner::executeIfExist(const TaskStep& step) {
     QPoint pos;
-    for (const auto& img : step.images) {
-        if (checkImageExists(img, step.threshold, &pos)) {
-            lastMatchedPos_ = pos;
-            return true;
-        }
+    auto frame = captureFrame();
+    if (checkAnyImageExists(step.images, step.threshold, &pos, frame.get())) {
+        lastMatchedPos_ = pos;
+        return true;
     }
     return false;
 }
 
 bool ScriptRunner::executeIfExistClick(const TaskStep& step) {
     QPoint pos;
-    for (const auto& img : step.images) {
-        if (checkImageExists(img, step.threshold, &pos)) {
-            pos += step.clickOffset;
-            lastMatchedPos_ = pos;
-            clickAtPoint(pos);
-
-            if (step.sleepMs > 0) {
-                sleepMs(step.sleepMs);
-            }
-            return true;
-        }
+    auto frame = captureFrame();
+    if (checkAnyImageExists(step.images, step.threshold, &pos, frame.get())) {
+        pos += step.clickOffset;
+        lastMatchedPos_ = pos;
+        clickAndSettle(pos, step.sleepMs);
+        return true;
     }
     return false;
 }
@@ -350,6 +394,75 @@ bool ScriptRunner::executeLoopUntil(const TaskStep& step) {
     return false;
 }
 
+bool ScriptRunner::executeFindAll(const TaskStep& step, QString* jumpTo) {
+    if (!worker_ || step.images.isEmpty()) return false;
+
+    QStringList paths;
+    for (const auto& img : step.images) paths << resolveImagePath(img);
+
+    // 等到至少出现一个目标；所有目标都取自同一帧
+    QList<QPoint> hits;
+    QElapsedTimer timer;
+    timer.start();
+    while (hits.isEmpty()) {
+        if (shouldStop()) return false;
+        auto frame = captureFrame();
+        if (frame) {
+            hits = worker_->findAllTemplatePlaceholders(*frame, paths, step.threshold, step.maxCount,
+                                                        step.sortBy == "score", nullptr, nullptr, step.roi);
+        }
+        if (hits.isEmpty() && handleInterrupts(frame.get())) {
+            if (shouldStop()) return false;
+            timer.restart();
+            continue;
+        }
+        if (!hits.isEmpty() || timer.elapsed() >= step.timeout) break;
+        sleepMs(200);
+    }
+
+    if (hits.isEmpty()) return false;
+    emit log(QStringLiteral("[脚本] 找到 %1 个目标").arg(hits.size()));
+
+    // 依次以每个目标作为“上次匹配位置”执行子步骤（子步骤中的“点击”即点击该目标）
+    for (int i = 0; i < hits.size(); ++i) {
+        if (shouldStop()) return false;
+        lastMatchedPos_ = hits[i] + step.clickOffset;
+        for (const auto& subStep : step.subSteps) {
+            if (shouldStop()) return false;
+            const QString next = executeStep(subStep);
+            if (!interruptNext_.isEmpty()) return false;    // 中断规则接管，下一步由 execute 决定
+            if (!next.isEmpty() && next != "__NEXT__") {
+                // goto / end_success / end_fail：不再处理剩余目标
+                *jumpTo = next;
+                return true;
+            }
+        }
+        if (step.sleepMs > 0 && i + 1 < hits.size()) {
+            sleepMs(step.sleepMs);
+        }
+    }
+    return true;
+}
+
+bool ScriptRunner::executeClickAll(const TaskStep& step) {
+    if (!worker_ || step.images.isEmpty()) return false;
+
+    QStringList paths;
+    for (const auto& img : step.images) paths << resolveImagePath(img);
+
+    // 一次截图检测所有图片，按列表顺序点击，sleep_ms 为每次点击后的间隔
+    QStringList clicked;
+    int unverified = 0;
+    const int n = worker_->clickEach(paths, step.threshold, step.sleepMs, step.verifyClick,
+                                     step.clickOffset, &clicked, step.roi, &unverified);
+    if (unverified > 0) {
+        emit log(QStringLiteral("[脚本] 全部点击: %1/%2（另有 %3 次点击后画面无变化）").arg(n).arg(paths.size()).arg(unverified));
+    } else {
+        emit log(QStringLiteral("[脚本] 全部点击: %1/%2").arg(n).arg(paths.size()));
+    }
+    return n > 0;
+}
+
 bool ScriptRunner::waitForImage(const QStringList& images, double threshold, int timeout,
                                  const QString& matchMode, QPoint* outPos) {
     if (images.isEmpty()) return false;
@@ -360,13 +473,16 @@ bool ScriptRunner::waitForImage(const QStringList& images, double threshold, int
     while (timer.elapsed() < timeout) {
         if (shouldStop()) return false;
 
+        // 每轮只截一次图，所有候选图片在同一帧上匹配
+        auto frame = captureFrame();
+
         if (matchMode == "all") {
             // 所有图片都要匹配
             bool allMatched = true;
             QPoint firstPos;
             for (const auto& img : images) {
                 QPoint pos;
-                if (!checkImageExists(img, threshold, &pos)) {
+                if (!checkImageExists(img, threshold, &pos, frame.get())) {
                     allMatched = false;
                     break;
                 }
@@ -378,25 +494,125 @@ bool ScriptRunner::waitForImage(const QStringList& images, double threshold, int
             }
         } else {
             // 任意一个图片匹配即可
-            for (const auto& img : images) {
-                QPoint pos;
-                if (checkImageExists(img, threshold, &pos)) {
-                    if (outPos) *outPos = pos;
-                    return true;
-                }
+            QPoint pos;
+            if (checkAnyImageExists(images, threshold, &pos, frame.get())) {
+                if (outPos) *outPos = pos;
+                return true;
             }
         }
 
+        // 目标没出现时看看是不是被弹窗挡住了；处理后重新计时，不把弹窗耗掉的时间算进超时
+        if (handleInterrupts(frame.get())) {
+            if (shouldStop()) return false;
+            timer.restart();
+            continue;
+        }
+
         sleepMs(200);
     }
 
     return false;
 }
 
-bool ScriptRunner::checkImageExists(const QString& image, double threshold, QPoint* outPos) {
-    if (!worker_) return false;
+bool ScriptRunner::handleInterrupts(const vision::Frame* frame) {
+    if (!frame || !worker_ || currentTask_.interrupts.isEmpty()) return false;
 
-    // 解析图片路径
+    // 与本轮目标共用同一帧：仍可触发的规则用到的模板一次匹配完，多条规则共用的模板只匹配一次
+    QVector<bool> wanted;
+    wanted.fill(false, interruptTargets_.size());
+    for (int i = 0; i < ruleTargets_.size(); ++i) {
+        if (interruptCounts_[i] >= currentTask_.interrupts[i].maxTriggers) continue;
+        for (int t : ruleTargets_[i]) wanted[t] = true;
+    }
+    QVector<QPoint> hits;
+    hits.fill(QPoint(-1, -1), interruptTargets_.size());
+    for (int t = 0; t < interruptTargets_.size(); ++t) {
+        if (wanted[t]) hits[t] = matchInterruptTarget(interruptTargets_[t], *frame);
+    }
+
+    // 按规则顺序处理第一个命中的
+    for (int i = 0; i < currentTask_.interrupts.size(); ++i) {
+        const InterruptRule& rule = currentTask_.interrupts[i];
+        if (interruptCounts_[i] >= rule.maxTriggers) continue;
+
+        QPoint pos(-1, -1);
+        for (int t : ruleTargets_[i]) {
+            if (hits[t].x() >= 0) { pos = hits[t]; break; }
+        }
+        if (pos.x() < 0) continue;
+
+        ++interruptCounts_[i];
+        emit log(QStringLiteral("[脚本] 中断规则 [%1] 触发 (%2/%3)")
+                     .arg(rule.name).arg(interruptCounts_[i]).arg(rule.maxTriggers));
+
+        if (rule.action == "click") {
+            clickAndSettle(pos + rule.clickOffset, rule.sleepMs);
+        } else if (rule.action == "click_pos") {
+            clickAndSettle(rule.clickOffset, rule.sleepMs);
+        } else if (rule.sleepMs > 0) {
+            sleepMs(rule.sleepMs);
+        }
+
+        if (rule.resume == "fail") {
+            interruptNext_ = "__END_FAIL__" + QStringLiteral("中断规则 [%1] 触发").arg(rule.name);
+        } else if (rule.resume == "goto") {
+            interruptNext_ = rule.gotoStep;     // 目标已在任务开始时检查过
+        }
+        if (interruptCounts_[i] >= rule.maxTriggers) {
+            emit log(QStringLiteral("[脚本] 中断规则 [%1] 已达触发上限，本次任务不再检查").arg(rule.name));
+        }
+        return true;
+    }
+    return false;
+}
+
+void ScriptRunner::buildInterruptTargets() {
+    interruptTargets_.clear();
+    ruleTargets_.clear();
+    QHash<QString, int> known;      // 阈值|路径… -> interruptTargets_ 下标
+    for (const InterruptRule& rule : currentTask_.interrupts) {
+        QStringList resolved;
+        for (const auto& img : rule.images) resolved << resolveImagePath(img);
+
+        // 与 checkAnyImageExists 相同：某张图片所属的变体族全部成员都在列表中时，整族作为一项
+        QVector<int> targets;
+        QSet<QString> handled;
+        for (const QString& path : resolved) {
+            if (handled.contains(path) || missingImages_.contains(path)) continue;
+            QStringList paths{path};
+            auto family = vision::TemplateRegistry::instance().familyOf(path);
+            if (family) {
+                bool complete = true;
+                for (const auto& member : family->members) {
+                    if (!resolved.contains(member)) { complete = false; break; }
+                }
+                if (complete) paths = family->members;
+            }
+            for (const auto& p : paths) handled.insert(p);
+
+            const QString key = QString::number(rule.threshold) + "|" + paths.join("|");
+            int index = known.value(key, -1);
+            if (index < 0) {
+                index = interruptTargets_.size();
+                interruptTargets_.push_back(InterruptTarget{paths, rule.threshold});
+                known.insert(key, index);
+            }
+            targets << index;
+        }
+        ruleTargets_ << targets;
+    }
+}
+
+QPoint ScriptRunner::matchInterruptTarget(const InterruptTarget& target, const vision::Frame& frame) {
+    double score = 0.0;
+    if (target.paths.size() > 1) {
+        QString variant;
+        return worker_->findFamilyPlaceholder(frame, target.paths, &score, target.threshold, &variant);
+    }
+    return worker_->findTemplatePlaceholder(frame, target.paths.first(), &score, target.threshold);
+}
+
+QString ScriptRunner::resolveImagePath(const QString& image) const {
     QString imagePath = image;
 
     // 获取应用程序目录作为基础路径
@@ -413,23 +629,39 @@ bool ScriptRunner::checkImageExists(const QString& image, double threshold, QPoi
         // 相对路径，转换为绝对路径
         imagePath = appDir + "/" + image;
     }
+    return imagePath;
+}
 
-    // 检查文件是否存在
-    if (!QFile::exists(imagePath)) {
-        emit log(QStringLiteral("[脚本] 图片文件不存在: %1").arg(imagePath));
-        return false;
+std::shared_ptr<vision::Frame> ScriptRunner::captureFrame() {
+    if (!worker_) return nullptr;
+    auto frame = worker_->captureFrame();
+    if (!frame) {
+        emit log(QStringLiteral("[脚本] 无法捕获屏幕"));
     }
+    return frame;
+}
+
+bool ScriptRunner::checkImageExists(const QString& image, double threshold, QPoint* outPos,
+                                    const vision::Frame* frame) {
+    if (!worker_) return false;
+
+    // 解析图片路径
+    QString imagePath = resolveImagePath(image);
+
+    // 缺失的图片已在任务开始时报告过
+    if (missingImages_.contains(imagePath)) return false;
 
     // 直接使用 worker 的方法进行图像匹配，避免使用全局 toolbox
     // 这样可以避免多窗口同时执行时的竞态条件
-    QImage screen = worker_->capture();
-    if (screen.isNull()) {
-        emit log(QStringLiteral("[脚本] 无法捕获屏幕"));
-        return false;
+    std::shared_ptr<vision::Frame> own;
+    if (!frame) {
+        own = captureFrame();
+        if (!own) return false;
+        frame = own.get();
     }
 
     double score = 0.0;
-    QPoint pt = worker_->findTemplatePlaceholder(screen, imagePath, &score, threshold);
+    QPoint pt = worker_->findTemplatePlaceholder(*frame, imagePath, &score, threshold);
     if (pt.x() >= 0) {
         if (outPos) *outPos = pt;
         return true;
@@ -438,11 +670,61 @@ bool ScriptRunner::checkImageExists(const QString& image, double threshold, QPoi
     return false;
 }
 
+bool ScriptRunner::checkAnyImageExists(const QStringList& images, double threshold, QPoint* outPos,
+                                       const vision::Frame* frame) {
+    if (!worker_) return false;
+
+    std::shared_ptr<vision::Frame> own;
+    if (!frame) {
+        own = captureFrame();
+        if (!own) return false;
+        frame = own.get();
+    }
+
+    QStringList resolved;
+    for (const auto& img : images) resolved << resolveImagePath(img);
+
+    // 保持原有顺序；某张图片所属的变体族全部成员都在列表中时，整族只做一次形状匹配
+    QSet<QString> handled;
+    for (int i = 0; i < images.size(); ++i) {
+        if (handled.contains(resolved[i])) continue;
+
+        auto family = vision::TemplateRegistry::instance().familyOf(resolved[i]);
+        bool complete = family != nullptr;
+        if (family) {
+            for (const auto& member : family->members) {
+                if (!resolved.contains(member)) { complete = false; break; }
+            }
+        }
+
+        if (complete) {
+            for (const auto& member : family->members) handled.insert(member);
+            double score = 0.0;
+            QString variant;
+            QPoint pt = worker_->findFamilyPlaceholder(*frame, family->members, &score, threshold, &variant);
+            if (pt.x() >= 0) {
+                if (outPos) *outPos = pt;
+                return true;
+            }
+            continue;
+        }
+
+        handled.insert(resolved[i]);
+        if (checkImageExists(images[i], threshold, outPos, frame)) return true;
+    }
+    return false;
+}
+
 bool ScriptRunner::clickAtPoint(const QPoint& pos) {
     if (!worker_) return false;
     return worker_->clickAt(pos);
 }
 
+bool ScriptRunner::clickAndSettle(const QPoint& pos, int maxWaitMs) {
+    if (!worker_) return false;
+    return worker_->clickAndSettle(pos, maxWaitMs);
+}
+
 const TaskStep* ScriptRunner::findStepById(const QString& id) const {
     int idx = findStepIndexById(id);
     if (idx >= 0 && idx < currentTask_.steps.size()) {
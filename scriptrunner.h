@@ -3,10 +3,14 @@
 
 #include <QObject>
 #include <QMap>
+#include <QSet>
+#include <QVector>
 #include <atomic>
+#include <memory>
 #include "taskmodel.h"
 
 class AutomationWorker;
+namespace vision { class Frame; }
 
 // 脚本任务执行引擎
 // 解释执行 TaskDefinition 中定义的步骤
@@ -50,12 +54,36 @@ private:
     bool executeIfExistClick(const TaskStep& step);
     bool executeLoop(const TaskStep& step);
     bool executeLoopUntil(const TaskStep& step);
+    // 子步骤返回跳转（goto / end）时停止遍历，跳转目标写入 jumpTo
+    bool executeFindAll(const TaskStep& step, QString* jumpTo);
+    bool executeClickAll(const TaskStep& step);
 
     // 辅助方法
     bool waitForImage(const QStringList& images, double threshold, int timeout,
                       const QString& matchMode, QPoint* outPos = nullptr);
-    bool checkImageExists(const QString& image, double threshold, QPoint* outPos = nullptr);
+    // frame 为空时自行截图；传入同一帧可让多张图片共享一次截图与帧统计量
+    bool checkImageExists(const QString& image, double threshold, QPoint* outPos = nullptr,
+                          const vision::Frame* frame = nullptr);
+    // 任意一张图片存在即返回 true；完整出现的颜色变体族（绿色X/蓝色X/紫色X…）合并为一次匹配
+    bool checkAnyImageExists(const QStringList& images, double threshold, QPoint* outPos,
+                             const vision::Frame* frame);
+    // 在轮询的同一帧上检查中断规则，命中则立即处理；返回 true 表示处理了一次中断(画面已变，需重新截图)。
+    // 仍可触发的规则的模板先一次匹配完，再按规则顺序（优先级）处理第一个命中的。
+    // resume 为 goto/fail 时记入 interruptNext_，当前步骤随即结束
+    bool handleInterrupts(const vision::Frame* frame);
+    // 中断规则要匹配的模板：单张图片或完整出现的颜色变体族；各规则中模板与阈值都相同的合并为一项
+    struct InterruptTarget {
+        QStringList paths;          // 解析后的路径，多于一个时为变体族
+        double threshold = 0.85;
+    };
+    // 任务开始时按规则展开、去重（路径解析与变体族查找不再每帧重复）
+    void buildInterruptTargets();
+    QPoint matchInterruptTarget(const InterruptTarget& target, const vision::Frame& frame);
+    QString resolveImagePath(const QString& image) const;
+    std::shared_ptr<vision::Frame> captureFrame();
     bool clickAtPoint(const QPoint& pos);
+    // 点击后等画面稳定，步骤的 sleep_ms 作为上限
+    bool clickAndSettle(const QPoint& pos, int maxWaitMs);
     void sleepMs(int ms);
     bool shouldStop() const;
 
@@ -69,6 +97,11 @@ private:
     std::atomic<bool> stopped_{false};
     std::atomic<bool> running_{false};
     QPoint lastMatchedPos_;             // 上次匹配到的位置
+    QSet<QString> missingImages_;       // 任务开始时预加载发现不存在的图片（解析后的路径）
+    QVector<int> interruptCounts_;      // 各中断规则本次任务的触发次数
+    QVector<InterruptTarget> interruptTargets_;
+    QVector<QVector<int>> ruleTargets_; // 各中断规则用到的 interruptTargets_ 下标（按图片顺序）
+    QString interruptNext_;             // 中断规则要求的下一步(步骤ID 或 __END_FAIL__原因)，非空时当前步骤中止
 };
 
 #endif // SCRIPTRUNNER_H
@@ -1,4 +1,5 @@
 #include "stepwidget.h"
+#include "templatematcher.h"
 
 #include <QVBoxLayout>
 #include <QHBoxLayout>
@@ -8,6 +9,7 @@
 #include <QLineEdit>
 #include <QSpinBox>
 #include <QDoubleSpinBox>
+#include <QCheckBox>
 #include <QPushButton>
 #include <QListWidget>
 #include <QGroupBox>
@@ -15,6 +17,7 @@
 #include <QPainter>
 #include <QMouseEvent>
 #include <QFileInfo>
+#include <QCoreApplication>
 
 // ============== StepListItem ==============
 
@@ -78,6 +81,8 @@ QString StepListItem::getTypeIcon() const {
         case StepType::IfExistClick:  return QStringLiteral("IF+C");
         case StepType::Loop:          return QStringLiteral("L");
         case StepType::LoopUntil:     return QStringLiteral("LU");
+        case StepType::FindAll:       return QStringLiteral("ALL");
+        case StepType::ClickAll:      return QStringLiteral("ALL+C");
         case StepType::Goto:          return QStringLiteral("GO");
         case StepType::EndSuccess:    return QStringLiteral("OK");
         case StepType::EndFail:       return QStringLiteral("X");
@@ -156,6 +161,8 @@ void StepPropertyPanel::setupUI() {
     typeCombo_->addItem(QStringLiteral("存在则点"), static_cast<int>(StepType::IfExistClick));
     typeCombo_->addItem(QStringLiteral("循环"), static_cast<int>(StepType::Loop));
     typeCombo_->addItem(QStringLiteral("循环直到"), static_cast<int>(StepType::LoopUntil));
+    typeCombo_->addItem(QStringLiteral("查找全部"), static_cast<int>(StepType::FindAll));
+    typeCombo_->addItem(QStringLiteral("全部点击"), static_cast<int>(StepType::ClickAll));
     typeCombo_->addItem(QStringLiteral("跳转"), static_cast<int>(StepType::Goto));
     typeCombo_->addItem(QStringLiteral("成功结束"), static_cast<int>(StepType::EndSuccess));
     typeCombo_->addItem(QStringLiteral("失败结束"), static_cast<int>(StepType::EndFail));
@@ -220,6 +227,62 @@ void StepPropertyPanel::setupUI() {
 
     mainLayout->addWidget(imageGroup_);
 
+    // 模板设置组：作用于图片列表中选中的图片
+    connect(imageList_, &QListWidget::currentRowChanged, this, &StepPropertyPanel::onImageSelected);
+
+    templateGroup_ = new QGroupBox(QStringLiteral("模板设置"), this);
+    QGridLayout* tplLayout = new QGridLayout(templateGroup_);
+
+    tplNameLabel_ = new QLabel(this);
+    tplLayout->addWidget(tplNameLabel_, 0, 0, 1, 2);
+
+    tplLayout->addWidget(new QLabel(QStringLiteral("阈值:"), this), 1, 0);
+    tplThresholdSpin_ = new QDoubleSpinBox(this);
+    tplThresholdSpin_->setRange(0.0, 1.0);
+    tplThresholdSpin_->setSingleStep(0.05);
+    tplThresholdSpin_->setSpecialValueText(QStringLiteral("使用步骤阈值"));
+    connect(tplThresholdSpin_, QOverload<double>::of(&QDoubleSpinBox::valueChanged),
+            this, &StepPropertyPanel::onTemplateMetaChanged);
+    tplLayout->addWidget(tplThresholdSpin_, 1, 1);
+
+    tplLayout->addWidget(new QLabel(QStringLiteral("策略:"), this), 2, 0);
+    tplStrategyCombo_ = new QComboBox(this);
+    tplStrategyCombo_->addItem(QStringLiteral("自动"), QString());
+    tplStrategyCombo_->addItem(QStringLiteral("NCC"), "ncc");
+    tplStrategyCombo_->addItem(QStringLiteral("金字塔"), "pyramid");
+    tplStrategyCombo_->addItem(QStringLiteral("边缘"), "edge");
+    tplStrategyCombo_->addItem(QStringLiteral("精确像素"), "sad");
+    connect(tplStrategyCombo_, QOverload<int>::of(&QComboBox::currentIndexChanged),
+            this, &StepPropertyPanel::onTemplateMetaChanged);
+    tplLayout->addWidget(tplStrategyCombo_, 2, 1);
+
+    tplLayout->addWidget(new QLabel(QStringLiteral("缩放:"), this), 3, 0);
+    tplScaleSpin_ = new QDoubleSpinBox(this);
+    tplScaleSpin_->setRange(0.25, 4.0);
+    tplScaleSpin_->setSingleStep(0.05);
+    tplScaleSpin_->setValue(1.0);
+    connect(tplScaleSpin_, QOverload<double>::of(&QDoubleSpinBox::valueChanged),
+            this, &StepPropertyPanel::onTemplateMetaChanged);
+    tplLayout->addWidget(tplScaleSpin_, 3, 1);
+
+    tplLayout->addWidget(new QLabel(QStringLiteral("区域:"), this), 4, 0);
+    tplRoiEdit_ = new QLineEdit(this);
+    tplRoiEdit_->setPlaceholderText(QStringLiteral("x,y,宽,高 (留空为全屏)"));
+    connect(tplRoiEdit_, &QLineEdit::editingFinished, this, &StepPropertyPanel::onTemplateMetaChanged);
+    tplLayout->addWidget(tplRoiEdit_, 4, 1);
+
+    tplLayout->addWidget(new QLabel(QStringLiteral("族名:"), this), 5, 0);
+    tplFamilyEdit_ = new QLineEdit(this);
+    tplFamilyEdit_->setPlaceholderText(QStringLiteral("同族模板共享一次匹配"));
+    connect(tplFamilyEdit_, &QLineEdit::editingFinished, this, &StepPropertyPanel::onTemplateMetaChanged);
+    tplLayout->addWidget(tplFamilyEdit_, 5, 1);
+
+    tplMaskCheck_ = new QCheckBox(QStringLiteral("透明像素不参与匹配"), this);
+    connect(tplMaskCheck_, &QCheckBox::toggled, this, &StepPropertyPanel::onTemplateMetaChanged);
+    tplLayout->addWidget(tplMaskCheck_, 6, 0, 1, 2);
+
+    mainLayout->addWidget(templateGroup_);
+
     // 时间属性组
     timeGroup_ = new QGroupBox(QStringLiteral("时间设置"), this);
     QGridLayout* timeLayout = new QGridLayout(timeGroup_);
@@ -302,6 +365,32 @@ void StepPropertyPanel::setupUI() {
 
     mainLayout->addWidget(loopGroup_);
 
+    // 多目标属性组
+    multiGroup_ = new QGroupBox(QStringLiteral("多目标设置"), this);
+    QGridLayout* multiLayout = new QGridLayout(multiGroup_);
+
+    multiLayout->addWidget(new QLabel(QStringLiteral("最多目标:"), this), 0, 0);
+    maxCountSpin_ = new QSpinBox(this);
+    maxCountSpin_->setRange(1, 100);
+    maxCountSpin_->setValue(16);
+    connect(maxCountSpin_, QOverload<int>::of(&QSpinBox::valueChanged),
+            this, &StepPropertyPanel::onPropertyChanged);
+    multiLayout->addWidget(maxCountSpin_, 0, 1);
+
+    multiLayout->addWidget(new QLabel(QStringLiteral("排序:"), this), 1, 0);
+    sortByCombo_ = new QComboBox(this);
+    sortByCombo_->addItem(QStringLiteral("按位置"), "position");
+    sortByCombo_->addItem(QStringLiteral("按得分"), "score");
+    connect(sortByCombo_, QOverload<int>::of(&QComboBox::currentIndexChanged),
+            this, &StepPropertyPanel::onPropertyChanged);
+    multiLayout->addWidget(sortByCombo_, 1, 1);
+
+    verifyCheck_ = new QCheckBox(QStringLiteral("点击后校验画面变化"), this);
+    connect(verifyCheck_, &QCheckBox::toggled, this, &StepPropertyPanel::onPropertyChanged);
+    multiLayout->addWidget(verifyCheck_, 2, 0, 1, 2);
+
+    mainLayout->addWidget(multiGroup_);
+
     // 失败原因组
     failGroup_ = new QGroupBox(QStringLiteral("失败设置"), this);
     QHBoxLayout* failLayout = new QHBoxLayout(failGroup_);
@@ -318,10 +407,12 @@ void StepPropertyPanel::setupUI() {
 
     // 初始隐藏所有可选组
     imageGroup_->hide();
+    templateGroup_->hide();
     timeGroup_->hide();
     posGroup_->hide();
     gotoGroup_->hide();
     loopGroup_->hide();
+    multiGroup_->hide();
     failGroup_->hide();
 }
 
@@ -362,6 +453,11 @@ void StepPropertyPanel::setStep(const TaskStep& step) {
     maxIterSpin_->setValue(step.maxIterations);
     untilImageEdit_->setText(step.loopUntilImage);
 
+    // 设置多目标
+    maxCountSpin_->setValue(step.maxCount);
+    sortByCombo_->setCurrentIndex(step.sortBy == "score" ? 1 : 0);
+    verifyCheck_->setChecked(step.verifyClick);
+
     // 设置失败原因
     failReasonEdit_->setText(step.failReason);
 
@@ -379,6 +475,8 @@ void StepPropertyPanel::clear() {
     idEdit_->clear();
     descEdit_->clear();
     imageList_->clear();
+    metaPath_.clear();
+    templateGroup_->hide();
     timeoutSpin_->setValue(8000);
     sleepSpin_->setValue(0);
     xSpin_->setValue(0);
@@ -387,6 +485,9 @@ void StepPropertyPanel::clear() {
     onFailEdit_->clear();
     maxIterSpin_->setValue(1);
     untilImageEdit_->clear();
+    maxCountSpin_->setValue(16);
+    sortByCombo_->setCurrentIndex(0);
+    verifyCheck_->setChecked(false);
     failReasonEdit_->clear();
     updating_ = false;
 }
@@ -414,6 +515,9 @@ void StepPropertyPanel::onPropertyChanged() {
     currentStep_.onFail = onFailEdit_->text().trimmed();
     currentStep_.maxIterations = maxIterSpin_->value();
     currentStep_.loopUntilImage = untilImageEdit_->text().trimmed();
+    currentStep_.maxCount = maxCountSpin_->value();
+    currentStep_.sortBy = sortByCombo_->currentData().toString();
+    currentStep_.verifyClick = verifyCheck_->isChecked();
     currentStep_.failReason = failReasonEdit_->text().trimmed();
 
     emit stepChanged(currentStep_);
@@ -444,21 +548,30 @@ void StepPropertyPanel::updateUIForType(StepType type) {
     // 根据类型显示/隐藏相关属性组
     bool needImage = (type == StepType::WaitClick || type == StepType::WaitAppear ||
                       type == StepType::WaitDisappear || type == StepType::IfExist ||
-                      type == StepType::IfExistClick);
+                      type == StepType::IfExistClick || type == StepType::FindAll ||
+                      type == StepType::ClickAll);
     bool needTime = (type == StepType::WaitClick || type == StepType::WaitAppear ||
-                     type == StepType::WaitDisappear || type == StepType::Sleep);
+                     type == StepType::WaitDisappear || type == StepType::Sleep ||
+                     type == StepType::FindAll || type == StepType::ClickAll);
     bool needPos = (type == StepType::ClickPos || type == StepType::WaitClick ||
-                    type == StepType::IfExistClick);
+                    type == StepType::IfExistClick || type == StepType::FindAll ||
+                    type == StepType::ClickAll);
     bool needGoto = (type == StepType::WaitClick || type == StepType::WaitAppear ||
                      type == StepType::IfExist || type == StepType::Goto);
     bool needLoop = (type == StepType::Loop || type == StepType::LoopUntil);
+    bool needMulti = (type == StepType::FindAll || type == StepType::ClickAll);
     bool needFail = (type == StepType::EndFail);
 
     imageGroup_->setVisible(needImage);
+    templateGroup_->setVisible(needImage && !metaPath_.isEmpty());
     timeGroup_->setVisible(needTime);
     posGroup_->setVisible(needPos);
     gotoGroup_->setVisible(needGoto);
     loopGroup_->setVisible(needLoop);
+    multiGroup_->setVisible(needMulti);
+    maxCountSpin_->setEnabled(type == StepType::FindAll);
+    sortByCombo_->setEnabled(type == StepType::FindAll);
+    verifyCheck_->setEnabled(type == StepType::ClickAll);
     failGroup_->setVisible(needFail);
 
     // 更新标签
@@ -475,3 +588,70 @@ void StepPropertyPanel::updateImageList() {
         imageList_->addItem(QFileInfo(img).fileName());
     }
 }
+
+void StepPropertyPanel::setImageFolder(const QString& folder) {
+    imageFolder_ = folder;
+}
+
+// 与 ScriptRunner::resolveImagePath 的规则一致
+QString StepPropertyPanel::templatePath(const QString& image) const {
+    const QString appDir = QCoreApplication::applicationDirPath();
+    if (!image.contains('/') && !image.contains('\\')) {
+        return imageFolder_.isEmpty() ? appDir + "/" + image
+                                      : appDir + "/" + imageFolder_ + "/" + image;
+    }
+    return QFileInfo(image).isAbsolute() ? image : appDir + "/" + image;
+}
+
+void StepPropertyPanel::onImageSelected(int row) {
+    metaPath_.clear();
+    if (row >= 0 && row < currentStep_.images.size()) {
+        const QString path = templatePath(currentStep_.images[row]);
+        if (QFileInfo::exists(path)) metaPath_ = path;
+    }
+    templateGroup_->setVisible(imageGroup_->isVisible() && !metaPath_.isEmpty());
+    if (metaPath_.isEmpty()) return;
+
+    const vision::TemplateMeta meta = vision::TemplateRegistry::instance().meta(metaPath_);
+    const bool wasUpdating = updating_;
+    updating_ = true;
+    tplNameLabel_->setText(QFileInfo(metaPath_).fileName() +
+                           (meta.contentHash ? QString("  #%1").arg(meta.contentHash, 16, 16, QChar('0')) : QString()));
+    tplThresholdSpin_->setValue(meta.threshold);
+    tplStrategyCombo_->setCurrentIndex(meta.manual ? tplStrategyCombo_->findData(vision::strategyToString(meta.strategy)) : 0);
+    tplScaleSpin_->setValue(meta.scale);
+    tplRoiEdit_->setText(meta.roiHint.area() > 0
+                             ? QString("%1,%2,%3,%4").arg(meta.roiHint.x).arg(meta.roiHint.y)
+                                   .arg(meta.roiHint.width).arg(meta.roiHint.height)
+                             : QString());
+    tplFamilyEdit_->setText(meta.family);
+    tplMaskCheck_->setChecked(meta.useMask);
+    updating_ = wasUpdating;
+}
+
+void StepPropertyPanel::onTemplateMetaChanged() {
+    if (updating_ || metaPath_.isEmpty()) return;
+
+    auto& registry = vision::TemplateRegistry::instance();
+    vision::TemplateMeta meta = registry.meta(metaPath_);
+    meta.threshold = tplThresholdSpin_->value();
+    const QString strategy = tplStrategyCombo_->currentData().toString();
+    if (strategy.isEmpty()) {
+        // 改回自动：清除调优记录，下次加载时重新调优
+        if (meta.manual) meta.tunedFor = 0;
+        meta.manual = false;
+    } else {
+        meta.manual = true;
+        meta.strategy = vision::stringToStrategy(strategy);
+    }
+    meta.scale = tplScaleSpin_->value();
+    meta.roiHint = cv::Rect();
+    const QStringList roi = tplRoiEdit_->text().split(',', Qt::SkipEmptyParts);
+    if (roi.size() == 4) {
+        meta.roiHint = cv::Rect(roi[0].trimmed().toInt(), roi[1].trimmed().toInt(),
+                                roi[2].trimmed().toInt(), roi[3].trimmed().toInt());
+    }
+    meta.family = tplFamilyEdit_->text().trimmed();
+    meta.useMask = tplMaskCheck_->isChecked();
+    registry.setMeta(metaPath_, meta);
+}
@@ -10,6 +10,7 @@ class QLabel;
 class QComboBox;
 class QLineEdit;
 class QSpinBox;
+class QCheckBox;
 class QDoubleSpinBox;
 class QPushButton;
 class QListWidget;
@@ -63,6 +64,9 @@ public:
 
     void clear();
 
+    // 任务图片目录（相对程序目录），用于定位模板文件以编辑其清单设置
+    void setImageFolder(const QString& folder);
+
 signals:
     void stepChanged(const TaskStep& step);
     void captureRequested();    // 请求截图
@@ -75,11 +79,17 @@ private slots:
     void onRemoveImage();
     void onCaptureImage();
     void onSelectImage();
+    void onImageSelected(int row);
+    void onTemplateMetaChanged();
 
 private:
     void setupUI();
     void updateUIForType(StepType type);
     void updateImageList();
+    QString templatePath(const QString& image) const;
+
+    QString imageFolder_;
+    QString metaPath_;       // 模板设置组当前编辑的模板（绝对路径）
 
     TaskStep currentStep_;
     bool updating_ = false;  // 防止循环更新
@@ -99,6 +109,16 @@ private:
     QComboBox* matchModeCombo_;
     QDoubleSpinBox* thresholdSpin_;
 
+    // 模板设置（写入图片目录的 templates.json，对所有引用该图片的步骤生效）
+    QGroupBox* templateGroup_;
+    QLabel* tplNameLabel_;
+    QDoubleSpinBox* tplThresholdSpin_;
+    QComboBox* tplStrategyCombo_;
+    QDoubleSpinBox* tplScaleSpin_;
+    QCheckBox* tplMaskCheck_;
+    QLineEdit* tplFamilyEdit_;
+    QLineEdit* tplRoiEdit_;
+
     // 时间相关
     QGroupBox* timeGroup_;
     QSpinBox* timeoutSpin_;
@@ -119,6 +139,12 @@ private:
     QSpinBox* maxIterSpin_;
     QLineEdit* untilImageEdit_;
 
+    // 多目标相关
+    QGroupBox* multiGroup_;
+    QSpinBox* maxCountSpin_;
+    QComboBox* sortByCombo_;
+    QCheckBox* verifyCheck_;
+
     // 失败原因
     QGroupBox* failGroup_;
     QLineEdit* failReasonEdit_;
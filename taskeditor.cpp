@@ -1,6 +1,8 @@
 #include "taskeditor.h"
 #include "stepwidget.h"
 #include "screencapture.h"
+#include "templatematcher.h"
+#include "templatepack.h"
 
 #include <QVBoxLayout>
 #include <QHBoxLayout>
@@ -179,6 +181,11 @@ void TaskEditor::setupMenus() {
     QMenu* runMenu = menuBar()->addMenu(QStringLiteral("运行(&R)"));
     runMenu->addAction(QStringLiteral("测试运行(&T)"), this, &TaskEditor::onTestRun,
                        QKeySequence(Qt::Key_F5));
+
+    // 工具菜单
+    QMenu* toolMenu = menuBar()->addMenu(QStringLiteral("工具(&T)"));
+    toolMenu->addAction(QStringLiteral("查找重复图片"), this, &TaskEditor::onFindDuplicateImages);
+    toolMenu->addAction(QStringLiteral("生成模板包"), this, &TaskEditor::onBuildTemplatePack);
 }
 
 void TaskEditor::setupToolBar() {
@@ -246,6 +253,7 @@ void TaskEditor::onNewTask() {
 
     refreshStepList();
     propertyPanel_->clear();
+    propertyPanel_->setImageFolder(currentTask_.imageFolder);
 
     appendLog(QStringLiteral("新建任务: %1").arg(name));
 
@@ -334,6 +342,7 @@ void TaskEditor::loadTask(const QString& path) {
     setWindowTitle(QStringLiteral("任务编辑器 - %1").arg(currentTask_.name));
     refreshStepList();
     propertyPanel_->clear();
+    propertyPanel_->setImageFolder(currentTask_.imageFolder);
     selectedStepIndex_ = -1;
 
     appendLog(QStringLiteral("加载任务: %1 (共 %2 步)")
@@ -518,6 +527,8 @@ void TaskEditor::onImageCaptured(const QImage& image, const QRect& region) {
 
         QString path = dir + "/" + fileName + ".png";
         if (img.save(path)) {
+            // 覆盖旧图时丢弃模板缓存与目录索引
+            vision::TemplateRegistry::instance().invalidate(path);
             // 添加图片到当前步骤
             if (selectedStepIndex_ >= 0 && selectedStepIndex_ < currentTask_.steps.size()) {
                 currentTask_.steps[selectedStepIndex_].images << (fileName + ".png");
@@ -543,6 +554,39 @@ void TaskEditor::onTestRun() {
     emit runTaskRequested(currentTask_);
 }
 
+void TaskEditor::onFindDuplicateImages() {
+    // 内容完全相同的图片在运行时共享同一个已编译模板，这里只是列出来便于整理
+    const QString root = QApplication::applicationDirPath() + QStringLiteral("/游戏图片");
+    const QList<QStringList> groups = vision::TemplateRegistry::findDuplicates(root);
+    if (groups.isEmpty()) {
+        appendLog(QStringLiteral("未发现重复图片"));
+        return;
+    }
+    int redundant = 0;
+    for (const QStringList& group : groups) {
+        QStringList names;
+        for (const QString& path : group) names << QDir(root).relativeFilePath(path);
+        appendLog(QStringLiteral("重复: %1").arg(names.join(" = ")));
+        redundant += group.size() - 1;
+    }
+    appendLog(QStringLiteral("共 %1 组重复图片，可省去 %2 个文件").arg(groups.size()).arg(redundant));
+}
+
+void TaskEditor::onBuildTemplatePack() {
+    QApplication::setOverrideCursor(Qt::WaitCursor);
+    QString error;
+    const int n = vision::TemplatePack::build(vision::TemplatePack::defaultRoot(),
+                                              vision::TemplatePack::defaultPath(), &error);
+    QApplication::restoreOverrideCursor();
+
+    if (n < 0) {
+        appendLog(QStringLiteral("生成模板包失败: %1").arg(error));
+        return;
+    }
+    appendLog(QStringLiteral("模板包已生成: %1 个模板%2").arg(n)
+                  .arg(error.isEmpty() ? QString() : QStringLiteral("（%1，下次启动时生效）").arg(error)));
+}
+
 void TaskEditor::appendLog(const QString& msg) {
     QString timestamp = QDateTime::currentDateTime().toString("[hh:mm:ss] ");
     logOutput_->append(timestamp + msg);
@@ -59,6 +59,10 @@ private slots:
     // 运行操作
     void onTestRun();
 
+    // 工具
+    void onFindDuplicateImages();
+    void onBuildTemplatePack();
+
     // 日志
     void appendLog(const QString& msg);
 
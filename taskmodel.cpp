@@ -1,8 +1,12 @@
 #include "taskmodel.h"
+#include "templatematcher.h"
 #include <QFile>
 #include <QDir>
 #include <QDebug>
 #include <QFileInfo>
+#include <QSet>
+#include <QJsonDocument>
+#include <QRegularExpression>
 
 // ============== 步骤类型转换 ==============
 
@@ -18,6 +22,8 @@ QString stepTypeToString(StepType type) {
         case StepType::IfExistClick:  return "if_exist_click";
         case StepType::Loop:          return "loop";
         case StepType::LoopUntil:     return "loop_until";
+        case StepType::FindAll:       return "find_all";
+        case StepType::ClickAll:      return "click_all";
         case StepType::Goto:          return "goto";
         case StepType::EndSuccess:    return "end_success";
         case StepType::EndFail:       return "end_fail";
@@ -36,6 +42,8 @@ StepType stringToStepType(const QString& str) {
     if (str == "if_exist_click") return StepType::IfExistClick;
     if (str == "loop")           return StepType::Loop;
     if (str == "loop_until")     return StepType::LoopUntil;
+    if (str == "find_all")       return StepType::FindAll;
+    if (str == "click_all")      return StepType::ClickAll;
     if (str == "goto")           return StepType::Goto;
     if (str == "end_success")    return StepType::EndSuccess;
     if (str == "end_fail")       return StepType::EndFail;
@@ -67,7 +75,14 @@ TaskStep TaskStep::fromJson(const QJsonObject& json) {
     step.onFail = json["on_fail"].toString();
     step.maxIterations = json["max_iterations"].toInt(1);
     step.loopUntilImage = json["until_image"].toString();
+    step.maxCount = json["max_count"].toInt(16);
+    step.sortBy = json["sort_by"].toString("position");
+    step.verifyClick = json["verify"].toBool(false);
     step.failReason = json["reason"].toString();
+    const QJsonArray roi = json["roi"].toArray();
+    if (roi.size() == 4) {
+        step.roi = QRect(roi[0].toInt(), roi[1].toInt(), roi[2].toInt(), roi[3].toInt());
+    }
 
     // 点击偏移
     if (json.contains("offset")) {
@@ -123,7 +138,11 @@ QJsonObject TaskStep::toJson() const {
     if (!onFail.isEmpty()) json["on_fail"] = onFail;
     if (maxIterations != 1) json["max_iterations"] = maxIterations;
     if (!loopUntilImage.isEmpty()) json["until_image"] = loopUntilImage;
+    if (maxCount != 16) json["max_count"] = maxCount;
+    if (sortBy != "position") json["sort_by"] = sortBy;
+    if (verifyClick) json["verify"] = true;
     if (!failReason.isEmpty()) json["reason"] = failReason;
+    if (!roi.isEmpty()) json["roi"] = QJsonArray{roi.x(), roi.y(), roi.width(), roi.height()};
 
     if (!clickOffset.isNull()) {
         if (type == StepType::ClickPos) {
@@ -159,6 +178,8 @@ QString TaskStep::displayName() const {
         case StepType::IfExistClick:  typeStr = QStringLiteral("存在则点"); break;
         case StepType::Loop:          typeStr = QStringLiteral("循环"); break;
         case StepType::LoopUntil:     typeStr = QStringLiteral("循环直到"); break;
+        case StepType::FindAll:       typeStr = QStringLiteral("查找全部"); break;
+        case StepType::ClickAll:      typeStr = QStringLiteral("全部点击"); break;
         case StepType::Goto:          typeStr = QStringLiteral("跳转"); break;
         case StepType::EndSuccess:    typeStr = QStringLiteral("成功结束"); break;
         case StepType::EndFail:       typeStr = QStringLiteral("失败结束"); break;
@@ -183,6 +204,59 @@ QString TaskStep::displayName() const {
     return QString("[%1]").arg(typeStr);
 }
 
+// ============== InterruptRule ==============
+
+InterruptRule InterruptRule::fromJson(const QJsonObject& json) {
+    InterruptRule rule;
+    rule.name = json["name"].toString();
+    if (json["image"].isString()) {
+        rule.images << json["image"].toString();
+    } else if (json["image"].isArray()) {
+        for (const auto& v : json["image"].toArray()) {
+            rule.images << v.toString();
+        }
+    }
+    if (rule.name.isEmpty() && !rule.images.isEmpty()) {
+        rule.name = QFileInfo(rule.images.first()).baseName();
+    }
+    rule.threshold = json["threshold"].toDouble(0.85);
+    rule.action = json["action"].toString("click");
+    rule.sleepMs = json["sleep_ms"].toInt(500);
+    rule.resume = json["resume"].toString("continue");
+    rule.gotoStep = json["goto"].toString();
+    rule.maxTriggers = json["max_triggers"].toInt(10);
+    if (json.contains("offset")) {
+        auto off = json["offset"].toObject();
+        rule.clickOffset = QPoint(off["x"].toInt(0), off["y"].toInt(0));
+    }
+    return rule;
+}
+
+QJsonObject InterruptRule::toJson() const {
+    QJsonObject json;
+    if (!name.isEmpty()) json["name"] = name;
+    if (images.size() == 1) {
+        json["image"] = images.first();
+    } else if (images.size() > 1) {
+        QJsonArray arr;
+        for (const auto& img : images) arr << img;
+        json["image"] = arr;
+    }
+    if (threshold != 0.85) json["threshold"] = threshold;
+    if (action != "click") json["action"] = action;
+    if (sleepMs != 500) json["sleep_ms"] = sleepMs;
+    if (resume != "continue") json["resume"] = resume;
+    if (!gotoStep.isEmpty()) json["goto"] = gotoStep;
+    if (maxTriggers != 10) json["max_triggers"] = maxTriggers;
+    if (!clickOffset.isNull()) {
+        QJsonObject off;
+        off["x"] = clickOffset.x();
+        off["y"] = clickOffset.y();
+        json["offset"] = off;
+    }
+    return json;
+}
+
 // ============== TaskDefinition ==============
 
 TaskDefinition TaskDefinition::fromJson(const QJsonObject& json) {
@@ -195,6 +269,13 @@ TaskDefinition TaskDefinition::fromJson(const QJsonObject& json) {
     for (const auto& v : json["steps"].toArray()) {
         task.steps << TaskStep::fromJson(v.toObject());
     }
+    for (const auto& v : json["interrupts"].toArray()) {
+        task.interrupts << InterruptRule::fromJson(v.toObject());
+    }
+    const QString problem = task.checkInterrupts();
+    if (!problem.isEmpty()) {
+        qWarning() << "[TaskDefinition]" << task.name << problem;
+    }
 
     return task;
 }
@@ -212,6 +293,14 @@ QJsonObject TaskDefinition::toJson() const {
     }
     json["steps"] = stepsArr;
 
+    if (!interrupts.isEmpty()) {
+        QJsonArray rulesArr;
+        for (const auto& rule : interrupts) {
+            rulesArr << rule.toJson();
+        }
+        json["interrupts"] = rulesArr;
+    }
+
     return json;
 }
 
@@ -258,9 +347,32 @@ bool TaskDefinition::isValid(QString* errorMsg) const {
         if (errorMsg) *errorMsg = QStringLiteral("任务步骤不能为空");
         return false;
     }
+    const QString problem = checkInterrupts();
+    if (!problem.isEmpty()) {
+        if (errorMsg) *errorMsg = problem;
+        return false;
+    }
     return true;
 }
 
+QString TaskDefinition::checkInterrupts() const {
+    QSet<QString> ids;
+    for (const auto& step : steps) {
+        if (!step.id.isEmpty()) ids.insert(step.id);
+    }
+    for (const auto& rule : interrupts) {
+        if (rule.resume != "goto") continue;
+        if (rule.gotoStep.isEmpty()) {
+            return QStringLiteral("中断规则 [%1] 的 resume 为 goto，但没有指定目标步骤").arg(rule.name);
+        }
+        // 除步骤ID外，也可以跳到执行器的特殊结果（__NEXT__、__END_SUCCESS__、__END_FAIL__…）
+        if (!ids.contains(rule.gotoStep) && rule.gotoStep != "__NEXT__" && !rule.gotoStep.startsWith("__END_")) {
+            return QStringLiteral("中断规则 [%1] 的目标步骤 %2 不存在").arg(rule.name, rule.gotoStep);
+        }
+    }
+    return QString();
+}
+
 static void collectImages(const QList<TaskStep>& steps, QStringList& images) {
     for (const auto& step : steps) {
         for (const auto& img : step.images) {
@@ -278,6 +390,13 @@ static void collectImages(const QList<TaskStep>& steps, QStringList& images) {
 QStringList TaskDefinition::getReferencedImages() const {
     QStringList images;
     collectImages(steps, images);
+    for (const auto& rule : interrupts) {
+        for (const auto& img : rule.images) {
+            if (!img.isEmpty() && !images.contains(img)) {
+                images << img;
+            }
+        }
+    }
     return images;
 }
 
@@ -295,28 +414,47 @@ bool TaskPackage::exportTask(const TaskDefinition& task,
 
     QDir dir;
     dir.mkpath(tempDir);
-    dir.mkpath(tempDir + "/images");
+    dir.mkpath(tempDir + "/blobs");
 
     // 保存任务JSON
     task.saveToFile(tempDir + "/task.json");
 
-    // 复制图片
+    // 图片按内容寻址：blobs/<内容哈希>.png 每种内容只存一份，images.json 记录文件名 -> 哈希
     QDir imgDir(imageFolder);
     QStringList images = task.getReferencedImages();
+    QJsonObject index;
+    int duplicates = 0;
     for (const auto& img : images) {
-        QString srcPath = imgDir.absoluteFilePath(img);
-        QString dstPath = tempDir + "/images/" + QFileInfo(img).fileName();
-        if (QFile::exists(srcPath)) {
-            QFile::copy(srcPath, dstPath);
-        }
+        QFile src(imgDir.absoluteFilePath(img));
+        if (!src.open(QIODevice::ReadOnly)) continue;
+        const QByteArray bytes = src.readAll();
+        const QString hash = QString("%1").arg(vision::xxhash64(bytes.constData(), static_cast<size_t>(bytes.size())),
+                                               16, 16, QChar('0'));
+        index[QFileInfo(img).fileName()] = hash;
+
+        QFile dst(tempDir + "/blobs/" + hash + ".png");
+        if (dst.exists()) { ++duplicates; continue; }
+        if (dst.open(QIODevice::WriteOnly)) dst.write(bytes);
+    }
+
+    QFile indexFile(tempDir + "/images.json");
+    if (indexFile.open(QIODevice::WriteOnly)) {
+        indexFile.write(QJsonDocument(index).toJson(QJsonDocument::Indented));
     }
 
     qDebug() << "[TaskPackage] Exported to:" << tempDir;
+    if (duplicates > 0) qDebug() << "[TaskPackage] Identical images stored once:" << duplicates;
     qDebug() << "[TaskPackage] Note: Use external tool to create .hjdz (zip) file";
 
     return true;
 }
 
+// 导出时 blobs/ 下的文件名：内容哈希的 16 位十六进制
+static bool isBlobHash(const QString& hash) {
+    static const QRegularExpression pattern("^[0-9a-fA-F]{16}$");
+    return pattern.match(hash).hasMatch();
+}
+
 bool TaskPackage::importTask(const QString& packagePath,
                              const QString& targetTaskDir,
                              const QString& targetImageDir,
@@ -337,10 +475,30 @@ bool TaskPackage::importTask(const QString& packagePath,
     }
 
     // 复制图片
-    QDir imgSrcDir(pkgDir.absoluteFilePath("images"));
     QDir imgDstDir(targetImageDir);
     imgDstDir.mkpath(".");
 
+    // 新格式：images.json + blobs/<内容哈希>.png
+    QFile indexFile(pkgDir.absoluteFilePath("images.json"));
+    if (indexFile.open(QIODevice::ReadOnly)) {
+        const QJsonObject index = QJsonDocument::fromJson(indexFile.readAll()).object();
+        for (const QString& name : index.keys()) {
+            // 包内容不可信：只取文件名部分，哈希必须是 16 位十六进制，防止写出/读出包目录之外
+            const QString fileName = QFileInfo(name).fileName();
+            const QString hash = index[name].toString();
+            if (fileName.isEmpty() || fileName.contains("..") || !isBlobHash(hash)) {
+                qWarning() << "[TaskPackage] Skipping invalid image entry:" << name << hash;
+                continue;
+            }
+            QString dstPath = imgDstDir.absoluteFilePath(fileName);
+            if (!QFile::exists(dstPath)) {
+                QFile::copy(pkgDir.absoluteFilePath("blobs/" + hash + ".png"), dstPath);
+            }
+        }
+    }
+
+    // 旧格式：images/ 下按文件名存放
+    QDir imgSrcDir(pkgDir.absoluteFilePath("images"));
     for (const auto& entry : imgSrcDir.entryInfoList(QDir::Files)) {
         QString dstPath = imgDstDir.absoluteFilePath(entry.fileName());
         if (!QFile::exists(dstPath)) {
@@ -5,6 +5,7 @@
 #include <QStringList>
 #include <QList>
 #include <QPoint>
+#include <QRect>
 #include <QJsonObject>
 #include <QJsonArray>
 #include <QJsonDocument>
@@ -21,6 +22,8 @@ enum class StepType {
     IfExistClick,   // 存在则点击
     Loop,           // 循环执行
     LoopUntil,      // 循环直到条件满足
+    FindAll,        // 一帧内找出所有目标，对每个目标执行子步骤
+    ClickAll,       // 一帧内检测多张图片，依次点击所有命中项
     Goto,           // 跳转到指定步骤
     EndSuccess,     // 任务成功结束
     EndFail         // 任务失败结束
@@ -45,6 +48,10 @@ struct TaskStep {
     QList<TaskStep> subSteps;   // 子步骤(用于循环/条件)
     int maxIterations = 1;      // 最大循环次数
     QString loopUntilImage;     // 循环终止条件图片
+    int maxCount = 16;          // 多目标：最多目标数
+    QString sortBy = "position"; // 多目标排序："position"(从上到下、从左到右) | "score"
+    bool verifyClick = false;   // 全部点击：点击后校验点击点附近画面是否变化
+    QRect roi;                  // 多目标：只在该区域(逻辑坐标)内查找；为空时用模板清单中的区域
     QString description;        // 步骤描述(用于显示)
     QString failReason;         // 失败原因(用于EndFail)
 
@@ -56,6 +63,24 @@ struct TaskStep {
     QString displayName() const;
 };
 
+// 中断规则(任务级)：随机弹窗、活动横幅等。每次轮询在同一帧上检查，命中立即处理，
+// 不必让当前步骤等到超时再重试
+struct InterruptRule {
+    QString name;               // 规则名(用于日志)
+    QStringList images;         // 触发图片，任一出现即触发
+    double threshold = 0.85;    // 匹配阈值
+    QString action = "click";   // "click" 点击触发位置(+offset) | "click_pos" 点击 offset 坐标 | "none" 不点击
+    QPoint clickOffset;         // 点击偏移 / 坐标
+    int sleepMs = 500;          // 处理后等画面稳定的上限
+    QString resume = "continue"; // "continue" 继续当前步骤并重新计时 | "goto" 跳到 gotoStep | "fail" 任务失败
+    QString gotoStep;           // resume 为 goto 时的目标步骤ID
+    int maxTriggers = 10;       // 单次任务最多触发次数，防止关不掉的弹窗死循环
+
+    // JSON序列化
+    static InterruptRule fromJson(const QJsonObject& json);
+    QJsonObject toJson() const;
+};
+
 // 任务定义
 struct TaskDefinition {
     QString name;               // 任务名称
@@ -63,6 +88,7 @@ struct TaskDefinition {
     QString imageFolder;        // 图片文件夹名(相对路径)
     int version = 1;            // 版本号
     QList<TaskStep> steps;      // 步骤列表
+    QList<InterruptRule> interrupts; // 中断规则
 
     // JSON序列化
     static TaskDefinition fromJson(const QJsonObject& json);
@@ -75,6 +101,9 @@ struct TaskDefinition {
     // 验证任务定义是否有效
     bool isValid(QString* errorMsg = nullptr) const;
 
+    // 中断规则的问题：resume 为 goto 但目标步骤为空或不存在。没有问题返回空
+    QString checkInterrupts() const;
+
     // 获取所有引用的图片文件
     QStringList getReferencedImages() const;
 };
@@ -0,0 +1,1752 @@
+#include "templatematcher.h"
+#include "templatetuner.h"
+#include "templatepack.h"
+
+#include <QFile>
+#include <QFileInfo>
+#include <QDir>
+#include <QDirIterator>
+#include <QThread>
+#include <QThreadPool>
+#include <QJsonDocument>
+#include <QJsonArray>
+#include <QSaveFile>
+#include <QDebug>
+#include <opencv2/imgproc.hpp>
+#include <opencv2/imgcodecs.hpp>
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define VISION_HAS_SSE2
+#endif
+
+namespace vision {
+
+QString strategyToString(MatchStrategy s) {
+    switch (s) {
+        case MatchStrategy::Ncc:  return "ncc";
+        case MatchStrategy::Edge: return "edge";
+        case MatchStrategy::Sad:  return "sad";
+        case MatchStrategy::Pyramid: return "pyramid";
+    }
+    return "ncc";
+}
+
+MatchStrategy stringToStrategy(const QString& str) {
+    if (str == "edge") return MatchStrategy::Edge;
+    if (str == "sad")  return MatchStrategy::Sad;
+    if (str == "pyramid") return MatchStrategy::Pyramid;
+    return MatchStrategy::Ncc;
+}
+
+static inline int popcount64(quint64 v) {
+#if defined(_MSC_VER) && defined(_M_X64)
+    return static_cast<int>(__popcnt64(v));
+#elif defined(__GNUC__)
+    return __builtin_popcountll(v);
+#else
+    v = v - ((v >> 1) & 0x5555555555555555ULL);
+    v = (v & 0x3333333333333333ULL) + ((v >> 2) & 0x3333333333333333ULL);
+    v = (v + (v >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+    return static_cast<int>((v * 0x0101010101010101ULL) >> 56);
+#endif
+}
+
+// ============== TemplateMeta ==============
+
+QJsonObject TemplateMeta::toJson() const {
+    QJsonObject json;
+    json["strategy"] = strategyToString(strategy);
+    if (sadTolerance != 4.0) json["sad_tolerance"] = sadTolerance;
+    if (manual) json["manual"] = true;
+    if (tunedFor != 0) {
+        json["tuned_for"] = QString::number(tunedFor);
+        json["speedup"] = speedup;
+    }
+    if (threshold > 0.0) json["threshold"] = threshold;
+    if (roiHint.area() > 0) {
+        QJsonArray roi;
+        roi << roiHint.x << roiHint.y << roiHint.width << roiHint.height;
+        json["roi"] = roi;
+    }
+    if (scale != 1.0) json["scale"] = scale;
+    if (useMask) json["mask"] = true;
+    if (!family.isEmpty()) json["family"] = family;
+    if (contentHash != 0) json["hash"] = QString::number(contentHash, 16);
+    return json;
+}
+
+TemplateMeta TemplateMeta::fromJson(const QJsonObject& json) {
+    TemplateMeta m;
+    m.strategy = stringToStrategy(json["strategy"].toString("ncc"));
+    m.sadTolerance = json["sad_tolerance"].toDouble(4.0);
+    m.manual = json["manual"].toBool(false);
+    m.tunedFor = json["tuned_for"].toString().toLongLong();
+    m.speedup = json["speedup"].toDouble(1.0);
+    m.threshold = json["threshold"].toDouble(0.0);
+    const QJsonArray roi = json["roi"].toArray();
+    if (roi.size() == 4) {
+        m.roiHint = cv::Rect(roi[0].toInt(), roi[1].toInt(), roi[2].toInt(), roi[3].toInt());
+    }
+    m.scale = json["scale"].toDouble(1.0);
+    if (m.scale <= 0.0) m.scale = 1.0;
+    m.useMask = json["mask"].toBool(false);
+    m.family = json["family"].toString();
+    m.contentHash = json["hash"].toString().toULongLong(nullptr, 16);
+    return m;
+}
+
+// ============== EdgeMap ==============
+
+static const int kEdgeThreshold = 96;  // |Gx|+|Gy| 超过该值视为边缘
+
+EdgeMap EdgeMap::build(const cv::Mat& bgr) {
+    EdgeMap m;
+    if (bgr.empty()) return m;
+
+    cv::Mat gray, gx, gy;
+    cv::cvtColor(bgr, gray, cv::COLOR_BGR2GRAY);
+    cv::Sobel(gray, gx, CV_16S, 1, 0, 3);
+    cv::Sobel(gray, gy, CV_16S, 0, 1, 3);
+
+    m.width = bgr.cols;
+    m.height = bgr.rows;
+    m.wordsPerRow = (m.width + 63) / 64 + 2;
+    m.bits.assign(static_cast<size_t>(m.height) * m.wordsPerRow, 0);
+
+    cv::Mat binary(m.height, m.width, CV_8UC1);
+    for (int y = 0; y < m.height; ++y) {
+        const short* dx = gx.ptr<short>(y);
+        const short* dy = gy.ptr<short>(y);
+        uchar* b = binary.ptr<uchar>(y);
+        quint64* row = m.bits.data() + static_cast<size_t>(y) * m.wordsPerRow;
+        for (int x = 0; x < m.width; ++x) {
+            const bool on = std::abs(dx[x]) + std::abs(dy[x]) >= kEdgeThreshold;
+            b[x] = on ? 1 : 0;
+            if (on) row[x >> 6] |= quint64(1) << (x & 63);
+        }
+    }
+    cv::integral(binary, m.count, CV_32S);
+    return m;
+}
+
+// ============== SceneHash ==============
+
+SceneHash SceneHash::compute(const cv::Mat& gray) {
+    SceneHash h;
+    if (gray.empty()) return h;
+
+    cv::Mat small;
+    cv::resize(gray, small, cv::Size(17, 16), 0, 0, cv::INTER_AREA);
+    int bit = 0;
+    for (int y = 0; y < 16; ++y) {
+        const uchar* row = small.ptr<uchar>(y);
+        for (int x = 0; x < 16; ++x, ++bit) {
+            if (row[x + 1] > row[x]) h.bits[bit >> 6] |= quint64(1) << (bit & 63);
+        }
+    }
+    h.valid = true;
+    return h;
+}
+
+int SceneHash::distance(const SceneHash& other) const {
+    int d = 0;
+    for (size_t i = 0; i < bits.size(); ++i) d += popcount64(bits[i] ^ other.bits[i]);
+    return d;
+}
+
+// ============== Frame ==============
+
+std::shared_ptr<Frame> Frame::fromImage(const QImage& img) {
+    if (img.isNull()) return nullptr;
+
+    QImage src = img;
+    if (src.format() != QImage::Format_RGB32 &&
+        src.format() != QImage::Format_ARGB32 &&
+        src.format() != QImage::Format_ARGB32_Premultiplied) {
+        src = src.convertToFormat(QImage::Format_RGB32);
+    }
+
+    // QImage -> cv::Mat (BGRA → BGR)
+    cv::Mat bgra(src.height(), src.width(), CV_8UC4,
+                 const_cast<uchar*>(src.constBits()), src.bytesPerLine());
+    cv::Mat bgr;
+    cv::cvtColor(bgra, bgr, cv::COLOR_BGRA2BGR);
+    return std::make_shared<Frame>(std::move(bgr));
+}
+
+const cv::Mat& Frame::bgrF() const {
+    if (bgrF_.empty() && !bgr_.empty()) {
+        bgr_.convertTo(bgrF_, CV_32F);
+    }
+    return bgrF_;
+}
+
+const EdgeMap& Frame::edges() const {
+    if (edges_.empty() && !bgr_.empty()) {
+        edges_ = EdgeMap::build(bgr_);
+    }
+    return edges_;
+}
+
+void Frame::ensureIntegrals() const {
+    if (sum_.empty() && !bgr_.empty()) {
+        cv::integral(bgr_, sum_, sqsum_, CV_64F, CV_64F);
+    }
+}
+
+const cv::Mat& Frame::integralSum() const {
+    ensureIntegrals();
+    return sum_;
+}
+
+const cv::Mat& Frame::integralSqSum() const {
+    ensureIntegrals();
+    return sqsum_;
+}
+
+const cv::Mat& Frame::gray() const {
+    if (gray_.empty() && !bgr_.empty()) {
+        cv::cvtColor(bgr_, gray_, cv::COLOR_BGR2GRAY);
+    }
+    return gray_;
+}
+
+const cv::Mat& Frame::grayF() const {
+    if (grayF_.empty() && !bgr_.empty()) {
+        gray().convertTo(grayF_, CV_32F);
+    }
+    return grayF_;
+}
+
+void Frame::ensureGrayIntegrals() const {
+    if (graySum_.empty() && !bgr_.empty()) {
+        cv::integral(gray(), graySum_, graySqSum_, CV_64F, CV_64F);
+    }
+}
+
+const cv::Mat& Frame::grayIntegralSum() const {
+    ensureGrayIntegrals();
+    return graySum_;
+}
+
+const cv::Mat& Frame::grayIntegralSqSum() const {
+    ensureGrayIntegrals();
+    return graySqSum_;
+}
+
+static const int kContentHashRowStride = 2;    // 每 2 行取 1 行参与内容哈希
+
+quint64 Frame::contentHash() const {
+    if (!hasContentHash_) {
+        quint64 h = xxhash64(nullptr, 0, (quint64(bgr_.cols) << 32) | quint64(bgr_.rows));
+        const size_t rowBytes = static_cast<size_t>(bgr_.cols) * bgr_.elemSize();
+        for (int y = 0; y < bgr_.rows; y += kContentHashRowStride) {
+            h = xxhash64(bgr_.ptr<uchar>(y), rowBytes, h);
+        }
+        contentHash_ = h;
+        hasContentHash_ = true;
+    }
+    return contentHash_;
+}
+
+const Frame& Frame::coarse() const {
+    if (!coarse_) {
+        cv::Mat half;
+        if (!bgr_.empty()) cv::pyrDown(bgr_, half);
+        coarse_ = std::make_shared<Frame>(half);
+    }
+    return *coarse_;
+}
+
+const SceneHash& Frame::sceneHash() const {
+    if (!sceneHash_.valid && !bgr_.empty()) {
+        sceneHash_ = SceneHash::compute(gray());
+    }
+    return sceneHash_;
+}
+
+// ============== CompiledTemplate ==============
+
+// 为 64 种位偏移各生成一份移位后的模板行，只保留内部像素（去掉 1 像素边框以避开 Sobel 边界效应）
+static void compileEdges(CompiledTemplate& t) {
+    const int tw = t.width();
+    const int th = t.height();
+    if (tw < 3 || th < 3) return;
+
+    const EdgeMap e = EdgeMap::build(t.bgr);
+    t.edgeCount = e.count.at<int>(th - 1, tw - 1) - e.count.at<int>(1, tw - 1)
+                - e.count.at<int>(th - 1, 1) + e.count.at<int>(1, 1);
+
+    t.edgeShifts.resize(64);
+    for (int s = 0; s < 64; ++s) {
+        auto& sh = t.edgeShifts[s];
+        sh.words = (s + tw + 63) / 64;
+        sh.bits.assign(static_cast<size_t>(th) * sh.words, 0);
+        sh.mask.assign(sh.words, 0);
+        for (int x = 1; x < tw - 1; ++x) {
+            const int b = s + x;
+            sh.mask[b >> 6] |= quint64(1) << (b & 63);
+        }
+        for (int y = 1; y < th - 1; ++y) {
+            const quint64* src = e.row(y);
+            quint64* dst = sh.bits.data() + static_cast<size_t>(y) * sh.words;
+            for (int x = 1; x < tw - 1; ++x) {
+                if ((src[x >> 6] >> (x & 63)) & 1) {
+                    const int b = s + x;
+                    dst[b >> 6] |= quint64(1) << (b & 63);
+                }
+            }
+        }
+    }
+}
+
+// withCoarse：是否同时生成 1/2 分辨率模板（粗模板本身不再向下生成）
+static std::shared_ptr<CompiledTemplate> compileTemplate(const QString& path, const cv::Mat& bgr,
+                                                         const TemplateMeta& meta, bool withCoarse,
+                                                         const cv::Mat& mask = cv::Mat()) {
+    auto t = std::make_shared<CompiledTemplate>();
+    t->path = path;
+    t->bgr = bgr;
+    t->meta = meta;
+    if (bgr.empty()) return t;
+
+    // 掩码模板只走掩码 NCC，边缘图与粗模板都用不上
+    if (!mask.empty() && mask.size() == bgr.size()) {
+        t->mask = mask;
+        withCoarse = false;
+    }
+
+    if (meta.strategy == MatchStrategy::Edge && t->mask.empty()) {
+        compileEdges(*t);
+    }
+
+    t->channelSum = cv::sum(bgr);
+    const double n = static_cast<double>(t->area());
+    const cv::Scalar mean(t->channelSum[0] / n, t->channelSum[1] / n, t->channelSum[2] / n);
+
+    bgr.convertTo(t->zeroMean, CV_32F);
+    cv::subtract(t->zeroMean, mean, t->zeroMean);
+    t->norm = cv::norm(t->zeroMean, cv::NORM_L2);
+
+    // 粗模板：两边都足够大时才有意义（太小的模板缩小后失去细节，且本身已经很快）
+    static const int kMinCoarseSide = 24;
+    if (withCoarse && bgr.cols >= kMinCoarseSide && bgr.rows >= kMinCoarseSide) {
+        cv::Mat half;
+        cv::pyrDown(bgr, half);
+        t->coarse = compileTemplate(path, half, TemplateMeta(), false);
+    }
+    return t;
+}
+
+std::shared_ptr<CompiledTemplate> CompiledTemplate::compile(const QString& path, const cv::Mat& bgr,
+                                                            const TemplateMeta& meta, const cv::Mat& mask) {
+    if (bgr.empty() || meta.scale == 1.0) return compileTemplate(path, bgr, meta, true, mask);
+
+    const cv::Size size(std::max(1, cvRound(bgr.cols * meta.scale)), std::max(1, cvRound(bgr.rows * meta.scale)));
+    cv::Mat scaled, scaledMask;
+    cv::resize(bgr, scaled, size, 0, 0, meta.scale < 1.0 ? cv::INTER_AREA : cv::INTER_LINEAR);
+    if (!mask.empty()) cv::resize(mask, scaledMask, size, 0, 0, cv::INTER_NEAREST);
+    return compileTemplate(path, scaled, meta, true, scaledMask);
+}
+
+std::shared_ptr<CompiledTemplate> CompiledTemplate::fromPlanes(const QString& path, const Planes& full,
+                                                               const Planes* coarse, const TemplateMeta& meta) {
+    auto t = std::make_shared<CompiledTemplate>();
+    t->path = path;
+    t->bgr = full.bgr;
+    t->zeroMean = full.zeroMean;
+    t->channelSum = full.channelSum;
+    t->norm = full.norm;
+    t->meta = meta;
+    if (meta.strategy == MatchStrategy::Edge && !t->bgr.empty()) {
+        compileEdges(*t);
+    }
+    if (coarse && !coarse->bgr.empty()) {
+        auto c = std::make_shared<CompiledTemplate>();
+        c->path = path;
+        c->bgr = coarse->bgr;
+        c->zeroMean = coarse->zeroMean;
+        c->channelSum = coarse->channelSum;
+        c->norm = coarse->norm;
+        t->coarse = c;
+    }
+    return t;
+}
+
+// ============== NCC ==============
+
+static cv::Rect clampSearch(const Frame& frame, const cv::Rect& search) {
+    const cv::Rect full(0, 0, frame.width(), frame.height());
+    if (search.width <= 0 || search.height <= 0) return full;
+    return search & full;
+}
+
+// NCC 核心：imageF / sum / sqsum 为同一平面（CN 通道）的浮点图与积分图
+template <int CN>
+static cv::Mat nccCore(const cv::Mat& imageF, const cv::Mat& sum, const cv::Mat& sqsum,
+                       const cv::Rect& area, const cv::Mat& zeroMean, double norm) {
+    typedef cv::Vec<double, CN> VecT;
+
+    const int tw = zeroMean.cols;
+    const int th = zeroMean.rows;
+    const int rw = area.width - tw + 1;
+    const int rh = area.height - th + 1;
+    if (rw <= 0 || rh <= 0) return {};
+
+    // 纯色模板：与 TM_CCOEFF_NORMED 一致，全部视为 1
+    if (norm < DBL_EPSILON) {
+        return cv::Mat(rh, rw, CV_32FC1, cv::Scalar(1.0));
+    }
+
+    // 分子：帧与零均值模板的互相关（模板均值为 0，窗口均值项自然消去，退化为点积）
+    cv::Mat result;
+    cv::matchTemplate(imageF(area), zeroMean, result, cv::TM_CCORR);
+
+    // 分母：窗口方差由该帧的积分图 O(1) 得到
+    const double invArea = 1.0 / (static_cast<double>(tw) * th);
+
+    for (int y = 0; y < rh; ++y) {
+        const int y0 = area.y + y;
+        const int y1 = y0 + th;
+        const VecT* s0 = sum.ptr<VecT>(y0);
+        const VecT* s1 = sum.ptr<VecT>(y1);
+        const VecT* q0 = sqsum.ptr<VecT>(y0);
+        const VecT* q1 = sqsum.ptr<VecT>(y1);
+        float* r = result.ptr<float>(y);
+
+        for (int x = 0; x < rw; ++x) {
+            const int x0 = area.x + x;
+            const int x1 = x0 + tw;
+            double var = 0.0;
+            for (int c = 0; c < CN; ++c) {
+                const double ws = s1[x1][c] - s1[x0][c] - s0[x1][c] + s0[x0][c];
+                const double wq = q1[x1][c] - q1[x0][c] - q0[x1][c] + q0[x0][c];
+                var += wq - ws * ws * invArea;
+            }
+            const double den = std::sqrt(std::max(var, 0.0)) * norm;
+
+            double num = r[x];
+            if (std::abs(num) < den) num /= den;
+            else if (std::abs(num) < den * 1.125) num = num > 0 ? 1.0 : -1.0;
+            else num = 0.0;
+            r[x] = static_cast<float>(num);
+        }
+    }
+    return result;
+}
+
+cv::Mat nccMap(const Frame& frame, const CompiledTemplate& tpl, const cv::Rect& search) {
+    if (frame.empty() || tpl.empty()) return {};
+    if (!tpl.mask.empty()) {
+        // 掩码 NCC 无法用积分图分解窗口方差，直接交给 OpenCV
+        const cv::Rect area = clampSearch(frame, search);
+        if (area.width < tpl.width() || area.height < tpl.height()) return {};
+        cv::Mat result;
+        cv::matchTemplate(frame.bgr()(area), tpl.bgr, result, cv::TM_CCOEFF_NORMED, tpl.mask);
+        cv::patchNaNs(result, 0.0);
+        return result;
+    }
+    return nccCore<3>(frame.bgrF(), frame.integralSum(), frame.integralSqSum(),
+                      clampSearch(frame, search), tpl.zeroMean, tpl.norm);
+}
+
+Hit matchNcc(const Frame& frame, const CompiledTemplate& tpl, double threshold,
+             const cv::Rect& search) {
+    Hit hit;
+    hit.size = cv::Size(tpl.width(), tpl.height());
+
+    cv::Mat result = nccMap(frame, tpl, search);
+    if (result.empty()) return hit;
+
+    double maxVal = 0.0;
+    cv::Point maxLoc;
+    cv::minMaxLoc(result, nullptr, &maxVal, nullptr, &maxLoc);
+
+    const cv::Rect area = clampSearch(frame, search);
+    hit.topLeft = cv::Point(area.x + maxLoc.x, area.y + maxLoc.y);
+    hit.score = maxVal;
+    hit.found = maxVal >= threshold;
+    return hit;
+}
+
+// ============== 金字塔 / 随时可返回 ==============
+
+static const int kPyramidCandidates = 3;        // 粗匹配保留的候选峰数
+static const double kPyramidCoarseSlack = 0.2;  // 粗匹配得分偏低，候选阈值放宽
+static const int kPyramidRefineMargin = 3;      // 全分辨率精化时候选四周的像素数
+
+Hit matchPyramid(const Frame& frame, const CompiledTemplate& tpl, double threshold,
+                 const cv::Rect& search) {
+    if (!tpl.coarse || frame.empty()) return matchNcc(frame, tpl, threshold, search);
+
+    const cv::Rect area = clampSearch(frame, search);
+    const cv::Rect coarseSearch(area.x / 2, area.y / 2, area.width / 2, area.height / 2);
+    std::vector<Hit> peaks = matchAll(frame.coarse(), *tpl.coarse, threshold - kPyramidCoarseSlack,
+                                      kPyramidCandidates, HitOrder::Score, 0.3, coarseSearch);
+
+    Hit best;
+    best.size = cv::Size(tpl.width(), tpl.height());
+    for (const Hit& p : peaks) {
+        const cv::Rect refine(p.topLeft.x * 2 - kPyramidRefineMargin, p.topLeft.y * 2 - kPyramidRefineMargin,
+                              tpl.width() + 2 * kPyramidRefineMargin + 1,
+                              tpl.height() + 2 * kPyramidRefineMargin + 1);
+        Hit h = matchNcc(frame, tpl, threshold, refine & area);
+        if (h.score > best.score) best = h;
+    }
+    return best;
+}
+
+static const int kAnytimeTile = 96;     // 分块边长（结果图坐标）
+
+Hit matchAnytime(const Frame& frame, const CompiledTemplate& tpl, double threshold,
+                 const MatchBudget& budget, bool* complete, cv::Mat* result) {
+    if (complete) *complete = false;
+    Hit best;
+    best.size = cv::Size(tpl.width(), tpl.height());
+    if (frame.empty() || tpl.empty()) return best;
+    threshold = effectiveThreshold(tpl, threshold);
+    const cv::Rect roiHint = budget.roiHint.width > 0 ? budget.roiHint : tpl.meta.roiHint;
+
+    const int tw = tpl.width();
+    const int th = tpl.height();
+    const int rw = frame.width() - tw + 1;
+    const int rh = frame.height() - th + 1;
+    if (rw <= 0 || rh <= 0) return best;
+
+    // 粗匹配结果图用于给分块排序（粗模板不存在时按自然顺序）。
+    // 粗匹配也按行带分段计算并检查截止时间：超时后剩余行带保持 -1，对应分块按自然顺序排在后面
+    const auto expired = [&budget]() {
+        return budget.deadline.hasExpired() || (budget.cancelled && budget.cancelled());
+    };
+    cv::Mat coarseMap;
+    if (tpl.coarse && !expired()) {
+        const Frame& small = frame.coarse();
+        const int ctw = tpl.coarse->width();
+        const int cth = tpl.coarse->height();
+        const int crw = small.width() - ctw + 1;
+        const int crh = small.height() - cth + 1;
+        if (crw > 0 && crh > 0) {
+            coarseMap.create(crh, crw, CV_32FC1);
+            coarseMap.setTo(cv::Scalar(-1.0));
+            const int band = kAnytimeTile / 2;
+            for (int y = 0; y < crh; y += band) {
+                if (y > 0 && expired()) break;
+                const int rows = std::min(band, crh - y);
+                cv::Mat part = nccMap(small, *tpl.coarse, cv::Rect(0, y, small.width(), rows + cth - 1));
+                if (!part.empty()) part.copyTo(coarseMap(cv::Rect(0, y, part.cols, part.rows)));
+            }
+        }
+    }
+
+    struct Tile { cv::Rect rect; double priority; };
+    std::vector<Tile> tiles;
+    for (int y = 0; y < rh; y += kAnytimeTile) {
+        for (int x = 0; x < rw; x += kAnytimeTile) {
+            Tile t;
+            t.rect = cv::Rect(x, y, std::min(kAnytimeTile, rw - x), std::min(kAnytimeTile, rh - y));
+            t.priority = 0.0;
+            if (!coarseMap.empty()) {
+                const cv::Rect c = cv::Rect(x / 2, y / 2, (t.rect.width + 1) / 2, (t.rect.height + 1) / 2)
+                                 & cv::Rect(0, 0, coarseMap.cols, coarseMap.rows);
+                if (c.width > 0 && c.height > 0) cv::minMaxLoc(coarseMap(c), nullptr, &t.priority);
+            }
+            if (t.rect.contains(budget.prior)) t.priority += 4.0;
+            if (roiHint.width > 0 && (cv::Rect(t.rect.x, t.rect.y, t.rect.width + tw - 1,
+                                               t.rect.height + th - 1) & roiHint).area() > 0) {
+                t.priority += 2.0;
+            }
+            tiles.push_back(t);
+        }
+    }
+    std::stable_sort(tiles.begin(), tiles.end(),
+                     [](const Tile& a, const Tile& b) { return a.priority > b.priority; });
+
+    if (result) {
+        result->create(rh, rw, CV_32FC1);
+        result->setTo(cv::Scalar(-1.0));
+    }
+
+    double bestScore = -2.0;
+    size_t done = 0;
+    for (; done < tiles.size(); ++done) {
+        if (done > 0 && expired()) break;
+
+        const cv::Rect& r = tiles[done].rect;
+        cv::Mat part = nccMap(frame, tpl, cv::Rect(r.x, r.y, r.width + tw - 1, r.height + th - 1));
+        if (part.empty()) continue;
+        if (result) part.copyTo((*result)(r));
+
+        double v = 0.0;
+        cv::Point loc;
+        cv::minMaxLoc(part, nullptr, &v, nullptr, &loc);
+        if (v > bestScore) {
+            bestScore = v;
+            best.topLeft = cv::Point(r.x + loc.x, r.y + loc.y);
+        }
+    }
+
+    if (complete) *complete = done == tiles.size();
+    if (bestScore < -1.0) return best;
+    best.score = bestScore;
+    best.found = bestScore >= threshold;
+    return best;
+}
+
+// ============== 多目标 ==============
+
+static double overlapRatio(const Hit& a, const Hit& b) {
+    const cv::Rect ra(a.topLeft, a.size);
+    const cv::Rect rb(b.topLeft, b.size);
+    const double inter = (ra & rb).area();
+    const double uni = static_cast<double>(ra.area()) + rb.area() - inter;
+    return uni > 0 ? inter / uni : 0.0;
+}
+
+std::vector<Hit> suppressOverlaps(std::vector<Hit> hits, double maxOverlap, int maxCount) {
+    std::stable_sort(hits.begin(), hits.end(),
+                     [](const Hit& a, const Hit& b) { return a.score > b.score; });
+
+    std::vector<Hit> kept;
+    for (const Hit& h : hits) {
+        if (maxCount > 0 && static_cast<int>(kept.size()) >= maxCount) break;
+        bool overlapped = false;
+        for (const Hit& k : kept) {
+            if (overlapRatio(h, k) > maxOverlap) { overlapped = true; break; }
+        }
+        if (!overlapped) kept.push_back(h);
+    }
+    return kept;
+}
+
+void sortHits(std::vector<Hit>& hits, HitOrder order) {
+    if (order == HitOrder::Score) {
+        std::stable_sort(hits.begin(), hits.end(),
+                         [](const Hit& a, const Hit& b) { return a.score > b.score; });
+        return;
+    }
+
+    // 按 y 排序后分行：与本行首个目标的中心 y 相差不足半个目标高度视为同一行，行内按 x
+    std::stable_sort(hits.begin(), hits.end(),
+                     [](const Hit& a, const Hit& b) { return a.center().y < b.center().y; });
+    std::vector<int> rows(hits.size(), 0);
+    int row = 0;
+    int rowY = hits.empty() ? 0 : hits.front().center().y;
+    for (size_t i = 0; i < hits.size(); ++i) {
+        if (hits[i].center().y - rowY > hits[i].size.height / 2) {
+            ++row;
+            rowY = hits[i].center().y;
+        }
+        rows[i] = row;
+    }
+    std::vector<size_t> idx(hits.size());
+    for (size_t i = 0; i < idx.size(); ++i) idx[i] = i;
+    std::stable_sort(idx.begin(), idx.end(), [&](size_t a, size_t b) {
+        if (rows[a] != rows[b]) return rows[a] < rows[b];
+        return hits[a].center().x < hits[b].center().x;
+    });
+    std::vector<Hit> sorted;
+    sorted.reserve(hits.size());
+    for (size_t i : idx) sorted.push_back(hits[i]);
+    hits.swap(sorted);
+}
+
+static const double kCandidateSlack = 0.15;    // 非 NCC 策略：NCC 候选峰的阈值放宽量
+static const int kCandidateMargin = 2;          // 非 NCC 策略：确认时在候选位置四周搜索的像素数
+
+std::vector<Hit> matchAll(const Frame& frame, const CompiledTemplate& tpl, double threshold,
+                          int maxCount, HitOrder order, double maxOverlap, const cv::Rect& search) {
+    std::vector<Hit> candidates;
+    const double requested = threshold;
+    threshold = effectiveThreshold(tpl, threshold);
+    // 与 match 相同按模板策略匹配：NCC（或带掩码）直接取结果图的峰；
+    // 其他策略先在 NCC 结果图上取放宽阈值的候选峰，再在每个候选附近用 match 按模板自身的策略确认
+    const bool direct = !tpl.mask.empty() || tpl.meta.strategy == MatchStrategy::Ncc;
+    const double peakThreshold = direct ? threshold : threshold - kCandidateSlack;
+    cv::Mat result = nccMap(frame, tpl, search);
+    if (result.empty()) return candidates;
+
+    const cv::Rect area = clampSearch(frame, search);
+    const cv::Size size(tpl.width(), tpl.height());
+
+    // 3x3 局部峰值；平台区域只保留扫描顺序上的第一个点
+    for (int y = 0; y < result.rows; ++y) {
+        const float* prev = y > 0 ? result.ptr<float>(y - 1) : nullptr;
+        const float* cur = result.ptr<float>(y);
+        const float* next = y + 1 < result.rows ? result.ptr<float>(y + 1) : nullptr;
+        for (int x = 0; x < result.cols; ++x) {
+            const float v = cur[x];
+            if (v < peakThreshold) continue;
+
+            bool peak = true;
+            for (int dx = -1; dx <= 1 && peak; ++dx) {
+                const int nx = x + dx;
+                if (nx < 0 || nx >= result.cols) continue;
+                if (prev && prev[nx] >= v) peak = false;
+                if (next && next[nx] > v) peak = false;
+            }
+            if (x > 0 && cur[x - 1] >= v) peak = false;
+            if (x + 1 < result.cols && cur[x + 1] > v) peak = false;
+            if (!peak) continue;
+
+            Hit h;
+            h.found = true;
+            h.topLeft = cv::Point(area.x + x, area.y + y);
+            h.size = size;
+            h.score = v;
+            candidates.push_back(h);
+        }
+    }
+
+    if (!direct) {
+        std::vector<Hit> verified;
+        for (const Hit& c : suppressOverlaps(std::move(candidates), maxOverlap, 0)) {
+            const cv::Rect around(c.topLeft.x - kCandidateMargin, c.topLeft.y - kCandidateMargin,
+                                size.width + 2 * kCandidateMargin, size.height + 2 * kCandidateMargin);
+            const Hit h = match(frame, tpl, requested, around & area);
+            if (h.found) verified.push_back(h);
+        }
+        candidates = std::move(verified);
+    }
+
+    std::vector<Hit> hits = suppressOverlaps(std::move(candidates), maxOverlap, maxCount);
+    sortHits(hits, order);
+    return hits;
+}
+
+// ============== Edge ==============
+
+Hit matchEdge(const Frame& frame, const CompiledTemplate& tpl, double threshold,
+              const cv::Rect& search) {
+    Hit hit;
+    hit.size = cv::Size(tpl.width(), tpl.height());
+    if (frame.empty() || tpl.empty() || tpl.edgeShifts.empty()) return hit;
+
+    const cv::Rect area = clampSearch(frame, search);
+    const int tw = tpl.width();
+    const int th = tpl.height();
+    const int rw = area.width - tw + 1;
+    const int rh = area.height - th + 1;
+    if (rw <= 0 || rh <= 0) return hit;
+
+    // 只比较模板内部 (tw-2)x(th-2) 像素
+    const int iw = tw - 2;
+    const int ih = th - 2;
+    const double n = static_cast<double>(iw) * ih;
+    const double a = tpl.edgeCount;
+    if (a <= 0 || a >= n) return hit;   // 无边缘 / 全边缘的模板无法定义相关系数
+
+    const EdgeMap& fe = frame.edges();
+    double best = -2.0;
+    cv::Point bestLoc;
+
+    for (int y = 0; y < rh; ++y) {
+        const int fy = area.y + y;
+        const int* c0 = fe.count.ptr<int>(fy + 1);
+        const int* c1 = fe.count.ptr<int>(fy + 1 + ih);
+
+        for (int x = 0; x < rw; ++x) {
+            const int fx = area.x + x;
+            const int ix0 = fx + 1;
+            const int ix1 = ix0 + iw;
+
+            // 窗口边缘像素数由积分图 O(1) 得到
+            const double b = c1[ix1] - c1[ix0] - c0[ix1] + c0[ix0];
+            if (b <= 0 || b >= n) continue;
+            const double den = std::sqrt(a * (n - a) * b * (n - b));
+
+            // 上界：重合边缘最多 min(a,b)，不可能超过当前最优则跳过 XOR
+            const double upper = (n * std::min(a, b) - a * b) / den;
+            if (upper <= best) continue;
+
+            // phi 随汉明距离单调下降，超过 maxHam 即可提前放弃该窗口
+            const double minOverlap = (best * den + a * b) / n;
+            const double maxHam = a + b - 2.0 * minOverlap;
+
+            const auto& sh = tpl.edgeShifts[fx & 63];
+            const int base = fx >> 6;
+            int ham = 0;
+            bool aborted = false;
+            for (int ty = 1; ty < th - 1; ++ty) {
+                const quint64* f = fe.row(fy + ty) + base;
+                const quint64* t = sh.bits.data() + static_cast<size_t>(ty) * sh.words;
+                for (int w = 0; w < sh.words; ++w) {
+                    ham += popcount64((f[w] ^ t[w]) & sh.mask[w]);
+                }
+                if (ham > maxHam) { aborted = true; break; }
+            }
+            if (aborted) continue;
+
+            const double overlap = (a + b - ham) * 0.5;
+            const double phi = (n * overlap - a * b) / den;
+            if (phi > best) {
+                best = phi;
+                bestLoc = cv::Point(fx, fy);
+            }
+        }
+    }
+
+    if (best < -1.0) return hit;
+    hit.topLeft = bestLoc;
+    hit.score = best;
+    hit.found = best >= threshold;
+    return hit;
+}
+
+// ============== SAD ==============
+
+// 一行连续字节的绝对差之和
+static inline int rowSad(const uchar* a, const uchar* b, int len) {
+    int sum = 0;
+    int i = 0;
+#if defined(__AVX2__)
+    __m256i acc = _mm256_setzero_si256();
+    for (; i + 32 <= len; i += 32) {
+        const __m256i va = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i));
+        const __m256i vb = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i));
+        acc = _mm256_add_epi64(acc, _mm256_sad_epu8(va, vb));
+    }
+    const __m128i acc128 = _mm_add_epi64(_mm256_castsi256_si128(acc), _mm256_extracti128_si256(acc, 1));
+    sum += _mm_cvtsi128_si32(acc128) + _mm_cvtsi128_si32(_mm_srli_si128(acc128, 8));
+#elif defined(VISION_HAS_SSE2)
+    __m128i acc = _mm_setzero_si128();
+    for (; i + 16 <= len; i += 16) {
+        const __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i));
+        const __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i));
+        acc = _mm_add_epi64(acc, _mm_sad_epu8(va, vb));
+    }
+    sum += _mm_cvtsi128_si32(acc) + _mm_cvtsi128_si32(_mm_srli_si128(acc, 8));
+#endif
+    for (; i < len; ++i) {
+        sum += std::abs(int(a[i]) - int(b[i]));
+    }
+    return sum;
+}
+
+Hit matchSad(const Frame& frame, const CompiledTemplate& tpl, double tolerance, double threshold,
+             const cv::Rect& search) {
+    Hit hit;
+    hit.size = cv::Size(tpl.width(), tpl.height());
+    if (frame.empty() || tpl.empty()) return hit;
+
+    const cv::Rect area = clampSearch(frame, search);
+    const int tw = tpl.width();
+    const int th = tpl.height();
+    const int rw = area.width - tw + 1;
+    const int rh = area.height - th + 1;
+    if (rw <= 0 || rh <= 0) return hit;
+
+    const int rowBytes = tw * 3;
+    const double totalBytes = static_cast<double>(rowBytes) * th;
+
+    // 运行上界：先取容差，找到候选后收紧为“严格优于当前最优”
+    long long bound = static_cast<long long>(tolerance * totalBytes);
+    long long best = -1;
+    cv::Point bestLoc;
+
+    const cv::Mat& img = frame.bgr();
+    for (int y = 0; y < rh && best != 0; ++y) {
+        const int fy = area.y + y;
+        for (int x = 0; x < rw; ++x) {
+            const int fx = area.x + x;
+            long long sad = 0;
+            int ty = 0;
+            for (; ty < th; ++ty) {
+                sad += rowSad(img.ptr<uchar>(fy + ty) + fx * 3, tpl.bgr.ptr<uchar>(ty), rowBytes);
+                if (sad > bound) break;
+            }
+            if (ty < th) continue;   // 提前终止
+
+            best = sad;
+            bound = sad - 1;
+            bestLoc = cv::Point(fx, fy);
+            if (sad == 0) break;     // 像素完全一致，无需继续
+        }
+    }
+
+    if (best < 0) return hit;
+    hit.topLeft = bestLoc;
+    hit.score = 1.0 - (static_cast<double>(best) / totalBytes) / 255.0;
+    hit.found = hit.score >= threshold;
+    return hit;
+}
+
+Hit match(const Frame& frame, const CompiledTemplate& tpl, double threshold,
+          const cv::Rect& search) {
+    threshold = effectiveThreshold(tpl, threshold);
+    if (!tpl.mask.empty()) return matchNcc(frame, tpl, threshold, search);
+
+    switch (tpl.meta.strategy) {
+        case MatchStrategy::Edge:
+            if (!tpl.edgeShifts.empty()) return matchEdge(frame, tpl, threshold, search);
+            break;
+        case MatchStrategy::Sad: {
+            Hit hit = matchSad(frame, tpl, tpl.meta.sadTolerance, threshold, search);
+            if (hit.found) return hit;
+            break;  // 超出容差（例如半透明叠加、缩放），回退 NCC
+        }
+        case MatchStrategy::Pyramid:
+            return matchPyramid(frame, tpl, threshold, search);
+        case MatchStrategy::Ncc:
+            break;
+    }
+    return matchNcc(frame, tpl, threshold, search);
+}
+
+// ============== 颜色变体模板族 ==============
+
+static const int kHueBins = 30;
+
+// 色相直方图：只统计饱和度、亮度足够的像素（灰白像素的色相没有意义），L1 归一化
+static cv::Mat hueHistogram(const cv::Mat& bgr) {
+    cv::Mat hsv, mask;
+    cv::cvtColor(bgr, hsv, cv::COLOR_BGR2HSV);
+    cv::inRange(hsv, cv::Scalar(0, 60, 40), cv::Scalar(180, 256, 256), mask);
+
+    const int channels[] = {0};
+    const int histSize[] = {kHueBins};
+    const float hueRange[] = {0.f, 180.f};
+    const float* ranges[] = {hueRange};
+
+    cv::Mat hist;
+    const bool colourful = cv::countNonZero(mask) > 0;
+    cv::calcHist(&hsv, 1, channels, colourful ? mask : cv::Mat(), hist, 1, histSize, ranges);
+    cv::normalize(hist, hist, 1.0, 0.0, cv::NORM_L1);
+    return hist;
+}
+
+std::shared_ptr<TemplateFamily> TemplateFamily::compile(
+        const QString& name, const std::vector<std::shared_ptr<const CompiledTemplate>>& members) {
+    auto f = std::make_shared<TemplateFamily>();
+    f->name = name;
+    f->sources = members;
+    if (members.empty()) return f;
+
+    // 各变体截图尺寸略有出入：居中裁到公共尺寸（不缩放，保持像素尺度）
+    int w = members.front()->width();
+    int h = members.front()->height();
+    for (const auto& m : members) {
+        w = std::min(w, m->width());
+        h = std::min(h, m->height());
+    }
+    if (w < 2 || h < 2) return f;
+
+    // 共享形状模板：各变体亮度的均值
+    cv::Mat acc = cv::Mat::zeros(h, w, CV_32FC1);
+    for (const auto& m : members) {
+        f->members << m->path;
+
+        const cv::Point off((m->width() - w) / 2, (m->height() - h) / 2);
+        f->cropOffsets.push_back(off);
+
+        cv::Mat g, gf;
+        cv::cvtColor(m->bgr(cv::Rect(off.x, off.y, w, h)), g, cv::COLOR_BGR2GRAY);
+        g.convertTo(gf, CV_32F);
+        acc += gf;
+
+        f->hueHists.push_back(hueHistogram(m->bgr));
+    }
+    acc /= static_cast<double>(members.size());
+    acc.convertTo(f->gray, CV_8U);
+
+    // 与 CompiledTemplate 相同的零均值预处理（基于取整后的 8 位模板）
+    f->gray.convertTo(f->zeroMean, CV_32F);
+    cv::subtract(f->zeroMean, cv::mean(f->zeroMean), f->zeroMean);
+    f->norm = cv::norm(f->zeroMean, cv::NORM_L2);
+    return f;
+}
+
+static const double kFamilyShapeSlack = 0.15;  // 均值亮度模板与单个变体的相关性偏低，形状阶段放宽阈值
+static const int kFamilyVerifyMargin = 4;      // 确认阶段在候选位置四周搜索的像素数
+
+FamilyHit matchFamily(const Frame& frame, const TemplateFamily& family, double threshold,
+                      const cv::Rect& search) {
+    FamilyHit out;
+    if (frame.empty() || family.empty()) return out;
+
+    // 1. 一次亮度 NCC 定位形状
+    const cv::Rect area = clampSearch(frame, search);
+    cv::Mat result = nccCore<1>(frame.grayF(), frame.grayIntegralSum(), frame.grayIntegralSqSum(),
+                                area, family.zeroMean, family.norm);
+    if (result.empty()) return out;
+
+    double maxVal = 0.0;
+    cv::Point maxLoc;
+    cv::minMaxLoc(result, nullptr, &maxVal, nullptr, &maxLoc);
+    out.hit.score = maxVal;
+    if (maxVal < threshold - kFamilyShapeSlack) return out;
+    const cv::Point shapeLoc(area.x + maxLoc.x, area.y + maxLoc.y);
+
+    // 2. 命中区域的色相直方图与各变体比较，按颜色距离从近到远排列
+    const cv::Mat crop = frame.bgr()(cv::Rect(shapeLoc, cv::Size(family.width(), family.height())));
+    const cv::Mat hist = hueHistogram(crop);
+    std::vector<std::pair<double, int>> byDistance;
+    for (size_t i = 0; i < family.hueHists.size(); ++i) {
+        byDistance.emplace_back(cv::compareHist(hist, family.hueHists[i], cv::HISTCMP_BHATTACHARYYA),
+                                static_cast<int>(i));
+    }
+    std::stable_sort(byDistance.begin(), byDistance.end(),
+                     [](const std::pair<double, int>& a, const std::pair<double, int>& b) { return a.first < b.first; });
+
+    // 3. 用变体自身模板在候选位置附近确认（搜索区域仅比模板大几个像素）；
+    //    色相分类出错时最近的变体确认不了，依次试其余变体，都不成立才算未命中
+    Hit best;
+    for (const auto& candidate : byDistance) {
+        const int v = candidate.second;
+        const CompiledTemplate& tpl = *family.sources[v];
+        const cv::Point origin = shapeLoc - family.cropOffsets[v];
+        const cv::Rect verify(origin.x - kFamilyVerifyMargin, origin.y - kFamilyVerifyMargin,
+                              tpl.width() + 2 * kFamilyVerifyMargin, tpl.height() + 2 * kFamilyVerifyMargin);
+        const Hit hit = match(frame, tpl, threshold, verify & area);
+        if (hit.found) {
+            out.hit = hit;
+            out.variant = v;
+            out.variantPath = family.members.value(v);
+            out.colourDistance = candidate.first;
+            return out;
+        }
+        if (hit.score > best.score) best = hit;
+    }
+    out.hit = best;
+    return out;
+}
+
+// ============== xxHash64 ==============
+
+static const quint64 kPrime1 = 11400714785074694791ULL;
+static const quint64 kPrime2 = 14029467366897019727ULL;
+static const quint64 kPrime3 = 1609587929392839161ULL;
+static const quint64 kPrime4 = 9650029242287828579ULL;
+static const quint64 kPrime5 = 2870177450012600261ULL;
+
+static inline quint64 rotl64(quint64 x, int r) { return (x << r) | (x >> (64 - r)); }
+
+static inline quint64 read64(const uchar* p) { quint64 v; std::memcpy(&v, p, 8); return v; }
+static inline quint32 read32(const uchar* p) { quint32 v; std::memcpy(&v, p, 4); return v; }
+
+static inline quint64 xxRound(quint64 acc, quint64 input) {
+    acc += input * kPrime2;
+    acc = rotl64(acc, 31);
+    return acc * kPrime1;
+}
+
+static inline quint64 xxMerge(quint64 acc, quint64 val) {
+    acc ^= xxRound(0, val);
+    return acc * kPrime1 + kPrime4;
+}
+
+quint64 xxhash64(const void* data, size_t len, quint64 seed) {
+    const uchar* p = static_cast<const uchar*>(data);
+    const uchar* end = p + len;
+    quint64 h;
+
+    if (len >= 32) {
+        quint64 v1 = seed + kPrime1 + kPrime2;
+        quint64 v2 = seed + kPrime2;
+        quint64 v3 = seed;
+        quint64 v4 = seed - kPrime1;
+        const uchar* limit = end - 32;
+        do {
+            v1 = xxRound(v1, read64(p)); p += 8;
+            v2 = xxRound(v2, read64(p)); p += 8;
+            v3 = xxRound(v3, read64(p)); p += 8;
+            v4 = xxRound(v4, read64(p)); p += 8;
+        } while (p <= limit);
+        h = rotl64(v1, 1) + rotl64(v2, 7) + rotl64(v3, 12) + rotl64(v4, 18);
+        h = xxMerge(h, v1);
+        h = xxMerge(h, v2);
+        h = xxMerge(h, v3);
+        h = xxMerge(h, v4);
+    } else {
+        h = seed + kPrime5;
+    }
+    h += static_cast<quint64>(len);
+
+    for (; p + 8 <= end; p += 8) {
+        h ^= xxRound(0, read64(p));
+        h = rotl64(h, 27) * kPrime1 + kPrime4;
+    }
+    if (p + 4 <= end) {
+        h ^= static_cast<quint64>(read32(p)) * kPrime1;
+        h = rotl64(h, 23) * kPrime2 + kPrime3;
+        p += 4;
+    }
+    for (; p < end; ++p) {
+        h ^= (*p) * kPrime5;
+        h = rotl64(h, 11) * kPrime1;
+    }
+
+    h ^= h >> 33;
+    h *= kPrime2;
+    h ^= h >> 29;
+    h *= kPrime3;
+    h ^= h >> 32;
+    return h;
+}
+
+// ============== MatchMemo ==============
+
+bool MatchMemo::lookup(quint64 frameHash, const QString& key, Hit* out) {
+    auto it = entries_.find(frameHash);
+    if (it == entries_.end()) return false;
+    auto hit = it.value().find(key);
+    if (hit == it.value().end()) return false;
+
+    order_.removeOne(frameHash);
+    order_.append(frameHash);
+    if (out) *out = hit.value();
+    ++saved_;
+    return true;
+}
+
+void MatchMemo::store(quint64 frameHash, const QString& key, const Hit& hit) {
+    if (!entries_.contains(frameHash)) {
+        while (order_.size() >= capacity_) {
+            entries_.remove(order_.takeFirst());
+        }
+        order_.append(frameHash);
+    }
+    entries_[frameHash].insert(key, hit);
+}
+
+void MatchMemo::clear() {
+    order_.clear();
+    entries_.clear();
+}
+
+// ============== IncrementalMatcher ==============
+
+std::vector<cv::Rect> IncrementalMatcher::dirtyRects(const cv::Mat& before, const cv::Mat& after) const {
+    const int bs = blockSize_;
+    const int bx = (after.cols + bs - 1) / bs;
+    const int by = (after.rows + bs - 1) / bs;
+
+    // 逐块逐行比较像素（同一渲染结果逐字节一致，任何变化都会被发现）
+    std::vector<cv::Rect> runs;
+    for (int j = 0; j < by; ++j) {
+        const int y0 = j * bs;
+        const int y1 = std::min(y0 + bs, after.rows);
+        int runStart = -1;
+        for (int i = 0; i <= bx; ++i) {
+            bool dirty = false;
+            if (i < bx) {
+                const int x0 = i * bs;
+                const size_t bytes = static_cast<size_t>(std::min(bs, after.cols - x0)) * after.elemSize();
+                for (int y = y0; y < y1 && !dirty; ++y) {
+                    dirty = std::memcmp(before.ptr<uchar>(y) + x0 * after.elemSize(),
+                                        after.ptr<uchar>(y) + x0 * after.elemSize(), bytes) != 0;
+                }
+            }
+            if (dirty && runStart < 0) runStart = i;
+            if (!dirty && runStart >= 0) {
+                const int x0 = runStart * bs;
+                const int x1 = std::min(i * bs, after.cols);
+                runs.push_back(cv::Rect(x0, y0, x1 - x0, y1 - y0));
+                runStart = -1;
+            }
+        }
+    }
+
+    // 上下相邻且横向范围相同的行段合并，减少重算区域的重叠
+    std::vector<cv::Rect> merged;
+    for (const cv::Rect& r : runs) {
+        bool joined = false;
+        for (cv::Rect& m : merged) {
+            if (m.x == r.x && m.width == r.width && m.y + m.height == r.y) {
+                m.height += r.height;
+                joined = true;
+                break;
+            }
+        }
+        if (!joined) merged.push_back(r);
+    }
+    return merged;
+}
+
+const std::vector<cv::Rect>& IncrementalMatcher::dirtyRectsCached(const cv::Mat& before, const cv::Mat& after) {
+    if (dirtyBefore_.data != before.data || dirtyAfter_.data != after.data ||
+        dirtyAfter_.size() != after.size()) {
+        dirty_ = dirtyRects(before, after);
+        dirtyBefore_ = before;
+        dirtyAfter_ = after;
+    }
+    return dirty_;
+}
+
+Hit IncrementalMatcher::match(const Frame& frame, const std::shared_ptr<const CompiledTemplate>& tpl,
+                              double threshold, const MatchBudget* budget, bool* complete) {
+    if (complete) *complete = true;
+    if (!tpl || tpl->meta.strategy != MatchStrategy::Ncc || !tpl->mask.empty() || frame.empty() || tpl->empty()) {
+        return tpl ? vision::match(frame, *tpl, threshold) : Hit();
+    }
+    threshold = effectiveThreshold(*tpl, threshold);
+
+    Hit hit;
+    hit.size = cv::Size(tpl->width(), tpl->height());
+    const int tw = tpl->width();
+    const int th = tpl->height();
+    const int rw = frame.width() - tw + 1;
+    const int rh = frame.height() - th + 1;
+    if (rw <= 0 || rh <= 0) return hit;
+
+    Entry& e = entries_[tpl->path];
+    order_.removeOne(tpl->path);
+    order_.append(tpl->path);
+    while (order_.size() > maxTemplates_) {
+        entries_.remove(order_.takeFirst());
+    }
+
+    const bool reusable = e.tpl == tpl && !e.result.empty() &&
+                          e.bgr.cols == frame.width() && e.bgr.rows == frame.height();
+    bool full = !reusable;
+
+    if (reusable && e.bgr.data != frame.bgr().data) {
+        // 变化块影响到的结果区域：窗口左上角落在 [块起点 - 模板尺寸 + 1, 块终点 - 1]
+        std::vector<cv::Rect> regions;
+        double area = 0.0;
+        const cv::Rect resultRect(0, 0, rw, rh);
+        for (const cv::Rect& d : dirtyRectsCached(e.bgr, frame.bgr())) {
+            const cv::Rect r = cv::Rect(d.x - tw + 1, d.y - th + 1, d.width + tw - 1, d.height + th - 1)
+                             & resultRect;
+            if (r.width <= 0 || r.height <= 0) continue;
+            regions.push_back(r);
+            area += r.area();
+        }
+
+        if (area > fullRescanRatio_ * resultRect.area()) {
+            full = true;
+        } else {
+            for (const cv::Rect& r : regions) {
+                const cv::Rect src(r.x, r.y, r.width + tw - 1, r.height + th - 1);
+                cv::Mat part = nccCore<3>(frame.bgrF(), frame.integralSum(), frame.integralSqSum(),
+                                          src, tpl->zeroMean, tpl->norm);
+                if (!part.empty()) part.copyTo(e.result(r));
+            }
+            ++partialUpdates_;
+        }
+    }
+
+    if (full) {
+        e.tpl = tpl;
+        ++fullScans_;
+        if (budget) {
+            // 预算内未完成：返回目前最佳，不保留不完整的结果图（下次仍整帧重扫）
+            MatchBudget b = *budget;
+            if (b.prior.x < 0) b.prior = e.lastHit;
+            bool done = false;
+            Hit partial = matchAnytime(frame, *tpl, threshold, b, &done, &e.result);
+            if (!done) {
+                e.result.release();
+                e.lastHit = partial.topLeft;
+                if (complete) *complete = false;
+                return partial;
+            }
+        } else {
+            e.result = nccMap(frame, *tpl);
+        }
+    }
+    e.bgr = frame.bgr();
+    if (e.result.empty()) return hit;
+
+    double maxVal = 0.0;
+    cv::Point maxLoc;
+    cv::minMaxLoc(e.result, nullptr, &maxVal, nullptr, &maxLoc);
+    e.lastHit = maxLoc;
+    hit.topLeft = maxLoc;
+    hit.score = maxVal;
+    hit.found = maxVal >= threshold;
+    return hit;
+}
+
+void IncrementalMatcher::clear() {
+    entries_.clear();
+    order_.clear();
+    dirtyBefore_.release();
+    dirtyAfter_.release();
+    dirty_.clear();
+}
+
+// ============== 帧差 ==============
+
+double regionDifference(const Frame& a, const Frame& b, const cv::Rect& region) {
+    if (a.empty() || b.empty() || a.width() != b.width() || a.height() != b.height()) {
+        return 255.0;   // 尺寸变化（窗口缩放等）视为完全不同
+    }
+    const cv::Rect r = clampSearch(a, region);
+    if (r.width <= 0 || r.height <= 0) return 0.0;
+
+    cv::Mat diff;
+    cv::absdiff(a.bgr()(r), b.bgr()(r), diff);
+    const cv::Scalar s = cv::sum(diff);
+    return (s[0] + s[1] + s[2]) / (3.0 * r.area());
+}
+
+// ============== 读图 ==============
+
+cv::Mat imreadSafe(const QString& filePath, int flags) {
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        qWarning() << "[imreadWithChinesePath] Cannot open file:" << filePath;
+        return {};
+    }
+    QByteArray data = file.readAll();
+    file.close();
+    std::vector<uchar> buf(data.begin(), data.end());
+    return cv::imdecode(buf, flags);
+}
+
+// ============== TemplateRegistry ==============
+
+// 颜色变体的文件名前缀（游戏中的品质色）
+static const QStringList& kColourPrefixes() {
+    static const QStringList prefixes = {
+        "绿色", "蓝色", "紫色", "橙色", "红色", "金色", "白色"
+    };
+    return prefixes;
+}
+
+TemplateRegistry& TemplateRegistry::instance() {
+    static TemplateRegistry registry;
+    return registry;
+}
+
+// 内容哈希 + 影响编译结果的预处理参数（边缘图、缩放、掩码）；相同即可共享同一份像素与统计量。
+// 阈值、ROI 等只影响匹配方式的元数据不在键内，按文件各自保留
+static QString blobKey(quint64 hash, const TemplateMeta& m) {
+    return QString("%1|%2|%3|%4")
+        .arg(hash, 16, 16, QChar('0'))
+        .arg(strategyToString(m.strategy))
+        .arg(m.scale).arg(m.useMask ? 1 : 0);
+}
+
+static bool sameMatchParams(const TemplateMeta& a, const TemplateMeta& b) {
+    return a.threshold == b.threshold && a.roiHint == b.roiHint && a.sadTolerance == b.sadTolerance;
+}
+
+// 共享的编译结果带着首个加载它的文件的路径、时间与元数据；其他文件得到各自的浅拷贝
+// （cv::Mat 与粗模板仍共享像素），替换路径、修改时间与元数据，按路径区分的缓存与家族成员不会串到别的文件
+static std::shared_ptr<const CompiledTemplate> viewFor(const std::shared_ptr<const CompiledTemplate>& blob,
+                                                       const QString& path, const QDateTime& modified,
+                                                       const TemplateMeta& m) {
+    if (blob->path == path && blob->modified == modified && sameMatchParams(blob->meta, m)) return blob;
+    auto view = std::make_shared<CompiledTemplate>(*blob);
+    view->path = path;
+    view->modified = modified;
+    view->meta = m;
+    view->shared = blob->shared ? blob->shared : blob;
+    return view;
+}
+
+std::shared_ptr<const CompiledTemplate> TemplateRegistry::get(const QString& path) {
+    const QFileInfo info(path);
+    QDateTime modified;
+    {
+        // 修改时间取自目录索引（prefetch / reload / invalidate 时重新扫描），命中缓存时不访问文件系统
+        QMutexLocker lock(&mutex_);
+        if (!indexedModified(path, &modified)) {
+            qWarning() << "[TemplateRegistry] cannot open:" << path;
+            return nullptr;
+        }
+        const CacheEntry cached = cache_.value(path);
+        if (cached.tpl && cached.modified == modified) return cached.tpl;
+    }
+
+    // 读取、解码与预计算放在锁外，避免阻塞其他窗口
+    auto readFile = [&](QByteArray* bytes) {
+        QFile file(path);
+        if (!file.open(QIODevice::ReadOnly)) {
+            qWarning() << "[TemplateRegistry] cannot open:" << path;
+            return false;
+        }
+        *bytes = file.readAll();
+        return true;
+    };
+
+    // 模板包里有且未过期时连文件都不用读：内容哈希、像素与统计量都在包内
+    const TemplatePack::Entry* packed = TemplatePack::instance().lookup(info);
+    QByteArray bytes;
+    if (!packed && !readFile(&bytes)) return nullptr;
+
+    // 清单中记录内容哈希：内容未变只是文件时间变了（复制、解包）时不必重新调优；内容变了则清除调优记录。
+    // 这里只更新内存中的元数据，正常运行不写资源目录；清单由调优器、模板编辑等工具写回
+    TemplateMeta m = meta(path);
+    const quint64 hash = packed ? packed->hash : xxhash64(bytes.constData(), static_cast<size_t>(bytes.size()));
+    const qint64 stamp = modified.toMSecsSinceEpoch();
+    bool dirty = false;
+    if (m.contentHash != hash || (m.tunedFor != 0 && m.tunedFor != stamp)) {
+        if (m.contentHash == hash) m.tunedFor = stamp;
+        else if (m.contentHash != 0) m.tunedFor = 0;
+        m.contentHash = hash;
+        dirty = true;
+    }
+    // 内容相同的副本（其他任务目录里的同一张图）已调优过时直接沿用，从而共享同一个已编译模板
+    if (!m.manual && m.tunedFor != stamp && adoptTuning(path, &m)) {
+        m.tunedFor = stamp;
+        dirty = true;
+    }
+    if (dirty) rememberMeta(path, m);
+
+    const QString key = blobKey(hash, m);
+    std::shared_ptr<const CompiledTemplate> tpl;
+    {
+        QMutexLocker lock(&mutex_);
+        tpl = blobs_.value(key).lock();
+        QStringList& paths = contentPaths_[hash];
+        const QString absPath = QFileInfo(path).absoluteFilePath();
+        if (!paths.contains(absPath)) {
+            paths << absPath;
+            if (paths.size() == 2) {
+                qInfo().noquote() << "[TemplateRegistry] 内容相同的模板:" << paths.join(" = ");
+            }
+        }
+    }
+
+    if (!tpl && packed && !m.useMask) {
+        // 包内平面只读映射、不复制；缩放时由映射的像素重新编译（仍省去解码）
+        auto compiled = m.scale == 1.0
+            ? CompiledTemplate::fromPlanes(path, packed->full, packed->hasCoarse ? &packed->coarse : nullptr, m)
+            : CompiledTemplate::compile(path, packed->full.bgr, m);
+        compiled->modified = modified;
+        compiled->contentHash = hash;
+        compiled->blobKey = key;
+        tpl = compiled;
+    }
+
+    if (!tpl) {
+        // 掩码需要 alpha 通道，包内只有 BGR，读原图
+        if (bytes.isEmpty() && !readFile(&bytes)) return nullptr;
+        const std::vector<uchar> buf(bytes.begin(), bytes.end());
+        cv::Mat bgr = cv::imdecode(buf, m.useMask ? cv::IMREAD_UNCHANGED : cv::IMREAD_COLOR);
+        if (bgr.empty()) {
+            qWarning() << "[TemplateRegistry] template empty:" << path;
+            return nullptr;
+        }
+        cv::Mat mask;
+        if (bgr.channels() == 4) {
+            std::vector<cv::Mat> planes;
+            cv::split(bgr, planes);
+            cv::threshold(planes[3], mask, 127, 255, cv::THRESH_BINARY);
+            cv::cvtColor(bgr, bgr, cv::COLOR_BGRA2BGR);
+        } else if (bgr.channels() == 1) {
+            cv::cvtColor(bgr, bgr, cv::COLOR_GRAY2BGR);
+        }
+        if (m.useMask && mask.empty()) {
+            qWarning() << "[TemplateRegistry] mask requested but template has no alpha:" << path;
+        }
+
+        auto compiled = CompiledTemplate::compile(path, bgr, m, mask);
+        compiled->modified = modified;
+        compiled->contentHash = hash;
+        compiled->blobKey = key;
+        tpl = compiled;
+    }
+
+    bool tune = false;
+    {
+        QMutexLocker lock(&mutex_);
+        // 另一线程可能同时编译了同一内容，以先登记的为准
+        auto existing = blobs_.value(key).lock();
+        if (existing) tpl = existing;
+        else blobs_.insert(key, tpl);
+        tpl = viewFor(tpl, path, modified, m);
+        cache_.insert(path, CacheEntry{modified, tpl});
+        tune = autoTune_ && !m.manual && m.tunedFor != stamp;
+    }
+    if (tune) TemplateTuner::instance().schedule(path);
+    return tpl;
+}
+
+bool TemplateRegistry::adoptTuning(const QString& path, TemplateMeta* m) {
+    const QString absPath = QFileInfo(path).absoluteFilePath();
+    QMutexLocker lock(&mutex_);
+    for (const QString& other : contentPaths_.value(m->contentHash)) {
+        if (other == absPath) continue;
+        const TemplateMeta o = meta_.value(other);
+        if (o.contentHash != m->contentHash || o.tunedFor == 0 || o.manual) continue;
+        m->strategy = o.strategy;
+        m->speedup = o.speedup;
+        return true;
+    }
+    return false;
+}
+
+QStringList TemplateRegistry::prefetch(const QStringList& paths) {
+    // 任务开始时重新扫描涉及的目录：上次运行之后增删、覆盖的图片在这里生效
+    QStringList existing;
+    QStringList missing;
+    {
+        QMutexLocker lock(&mutex_);
+        QSet<QString> folders;
+        for (const QString& path : paths) folders.insert(QFileInfo(path).absolutePath());
+        for (const QString& folder : folders) dropFolderIndex(folder);
+        QDateTime modified;
+        for (const QString& path : paths) {
+            if (indexedModified(path, &modified)) existing << path;
+            else missing << path;
+        }
+    }
+
+    QThreadPool pool;
+    pool.setMaxThreadCount(qMax(1, QThread::idealThreadCount()));
+    for (const QString& path : existing) {
+        pool.start([this, path]() {
+            get(path);
+            familyOf(path);     // 颜色变体族一并编译
+        });
+    }
+    pool.waitForDone();
+    return missing;
+}
+
+void TemplateRegistry::invalidate(const QString& path) {
+    QMutexLocker lock(&mutex_);
+    cache_.remove(path);
+    dropFolderIndex(QFileInfo(path).absolutePath());
+}
+
+void TemplateRegistry::clear() {
+    QMutexLocker lock(&mutex_);
+    cache_.clear();
+    blobs_.clear();
+    families_.clear();
+    folderIndex_.clear();
+    familyMembers_.clear();
+}
+
+void TemplateRegistry::reload() {
+    QMutexLocker lock(&mutex_);
+    folderIndex_.clear();
+    familyMembers_.clear();
+}
+
+// 编辑器可选的模板图片格式（与 TaskEditor 的文件对话框一致）
+static const QStringList& imageNameFilters() {
+    static const QStringList filters = {"*.png", "*.jpg", "*.jpeg", "*.bmp"};
+    return filters;
+}
+
+bool TemplateRegistry::indexedModified(const QString& path, QDateTime* modified) {
+    const QFileInfo info(path);
+    const QString folder = info.absolutePath();
+    auto it = folderIndex_.find(folder);
+    if (it == folderIndex_.end()) {
+        QHash<QString, QDateTime> files;
+        for (const QFileInfo& f : QDir(folder).entryInfoList(imageNameFilters(), QDir::Files)) {
+            files.insert(f.fileName(), f.lastModified());
+        }
+        it = folderIndex_.insert(folder, files);
+    }
+    auto file = it.value().constFind(info.fileName());
+    if (file == it.value().constEnd()) {
+        // 其他后缀（或大小写不同）的文件不在索引里：直接查文件，存在则补进索引
+        if (!info.exists()) return false;
+        it.value().insert(info.fileName(), info.lastModified());
+        *modified = info.lastModified();
+        return true;
+    }
+    *modified = file.value();
+    return true;
+}
+
+void TemplateRegistry::dropFolderIndex(const QString& folder) {
+    folderIndex_.remove(folder);
+    for (auto it = familyMembers_.begin(); it != familyMembers_.end();) {
+        if (QFileInfo(it.key()).absolutePath() == folder) it = familyMembers_.erase(it);
+        else ++it;
+    }
+}
+
+QList<QStringList> TemplateRegistry::duplicates() {
+    QMutexLocker lock(&mutex_);
+    QList<QStringList> groups;
+    for (auto it = contentPaths_.constBegin(); it != contentPaths_.constEnd(); ++it) {
+        if (it.value().size() > 1) groups << it.value();
+    }
+    return groups;
+}
+
+QList<QStringList> TemplateRegistry::findDuplicates(const QString& root) {
+    QHash<quint64, QStringList> byHash;
+    QDirIterator it(root, imageNameFilters(), QDir::Files, QDirIterator::Subdirectories);
+    while (it.hasNext()) {
+        const QString path = it.next();
+        QFile file(path);
+        if (!file.open(QIODevice::ReadOnly)) continue;
+        const QByteArray bytes = file.readAll();
+        byHash[xxhash64(bytes.constData(), static_cast<size_t>(bytes.size()))] << path;
+    }
+
+    QList<QStringList> groups;
+    for (auto h = byHash.constBegin(); h != byHash.constEnd(); ++h) {
+        if (h.value().size() < 2) continue;
+        QStringList paths = h.value();
+        paths.sort();
+        groups << paths;
+    }
+    return groups;
+}
+
+static const char* kMetaFileName = "templates.json";
+
+void TemplateRegistry::ensureFolderLoaded(const QString& folder) {
+    if (loadedFolders_.contains(folder)) return;
+    loadedFolders_.insert(folder);
+
+    QFile file(QDir(folder).filePath(kMetaFileName));
+    if (!file.open(QIODevice::ReadOnly)) return;
+    const QJsonObject templates = QJsonDocument::fromJson(file.readAll()).object()["templates"].toObject();
+    for (const QString& name : templates.keys()) {
+        meta_.insert(QDir(folder).filePath(name), TemplateMeta::fromJson(templates[name].toObject()));
+    }
+}
+
+void TemplateRegistry::saveFolder(const QString& folder) {
+    QJsonObject templates;
+    for (auto it = meta_.constBegin(); it != meta_.constEnd(); ++it) {
+        const QFileInfo info(it.key());
+        if (info.absolutePath() == folder) templates[info.fileName()] = it.value().toJson();
+    }
+    QJsonObject root;
+    root["version"] = 1;
+    root["templates"] = templates;
+
+    QSaveFile file(QDir(folder).filePath(kMetaFileName));
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "[TemplateRegistry] cannot write" << file.fileName();
+        return;
+    }
+    file.write(QJsonDocument(root).toJson(QJsonDocument::Indented));
+    file.commit();
+}
+
+TemplateMeta TemplateRegistry::meta(const QString& path) {
+    const QFileInfo info(path);
+    QMutexLocker lock(&mutex_);
+    ensureFolderLoaded(info.absolutePath());
+    return meta_.value(info.absoluteFilePath());
+}
+
+void TemplateRegistry::rememberMeta(const QString& path, const TemplateMeta& meta) {
+    const QFileInfo info(path);
+    QMutexLocker lock(&mutex_);
+    ensureFolderLoaded(info.absolutePath());
+    meta_[info.absoluteFilePath()] = meta;
+}
+
+void TemplateRegistry::storeMeta(const QString& path, const TemplateMeta& meta) {
+    const QFileInfo info(path);
+    QMutexLocker lock(&mutex_);
+    ensureFolderLoaded(info.absolutePath());
+    meta_[info.absoluteFilePath()] = meta;
+    saveFolder(info.absolutePath());
+}
+
+void TemplateRegistry::setMeta(const QString& path, const TemplateMeta& meta) {
+    storeMeta(path, meta);
+
+    const QFileInfo info(path);
+    QMutexLocker lock(&mutex_);
+
+    // 同一文件可能以相对/绝对两种路径被引用，缓存中的编译结果都要失效
+    for (auto it = cache_.begin(); it != cache_.end();) {
+        if (QFileInfo(it.key()).absoluteFilePath() == info.absoluteFilePath()) it = cache_.erase(it);
+        else ++it;
+    }
+}
+
+void TemplateRegistry::setAutoTune(bool enabled) {
+    QMutexLocker lock(&mutex_);
+    autoTune_ = enabled;
+}
+
+std::shared_ptr<const TemplateFamily> TemplateRegistry::family(const QStringList& members) {
+    if (members.isEmpty()) return nullptr;
+
+    // 成员经 get() 做修改时间校验；任一成员被重新编译则模板族随之重建
+    std::vector<std::shared_ptr<const CompiledTemplate>> sources;
+    for (const QString& path : members) {
+        auto tpl = get(path);
+        if (!tpl) return nullptr;
+        sources.push_back(tpl);
+    }
+
+    const QString key = members.join("|");
+    {
+        QMutexLocker lock(&mutex_);
+        auto cached = families_.value(key);
+        if (cached && cached->sources == sources) return cached;
+    }
+
+    QString name = QFileInfo(members.front()).completeBaseName();
+    for (const QString& prefix : kColourPrefixes()) {
+        if (name.startsWith(prefix)) { name = name.mid(prefix.size()); break; }
+    }
+    auto fam = TemplateFamily::compile(name, sources);
+
+    QMutexLocker lock(&mutex_);
+    families_.insert(key, fam);
+    return fam;
+}
+
+std::shared_ptr<const TemplateFamily> TemplateRegistry::familyOf(const QString& path) {
+    // 成员列表按模板缓存，随目录索引一起失效；轮询中只剩一次哈希查找
+    const QString absPath = QFileInfo(path).absoluteFilePath();
+    QStringList members;
+    {
+        QMutexLocker lock(&mutex_);
+        auto cached = familyMembers_.constFind(absPath);
+        if (cached != familyMembers_.constEnd()) {
+            members = cached.value();
+        } else {
+            ensureFolderLoaded(QFileInfo(path).absolutePath());
+            const QString name = meta_.value(absPath).family;
+            members = name.isEmpty() ? conventionFamilyMembers(path) : manifestFamilyMembers(path, name);
+            familyMembers_.insert(absPath, members);
+        }
+    }
+    if (members.size() < 2) return nullptr;
+    return family(members);
+}
+
+QStringList TemplateRegistry::manifestFamilyMembers(const QString& path, const QString& family) {
+    const QString folder = QFileInfo(path).absolutePath();
+    QStringList members;
+    QDateTime modified;
+    for (auto it = meta_.constBegin(); it != meta_.constEnd(); ++it) {
+        if (it.value().family == family && QFileInfo(it.key()).absolutePath() == folder &&
+            indexedModified(it.key(), &modified)) {
+            members << it.key();
+        }
+    }
+    members.sort();
+    return members;
+}
+
+QStringList TemplateRegistry::conventionFamilyMembers(const QString& path) {
+    const QFileInfo info(path);
+    const QString base = info.completeBaseName();
+
+    QString stem;
+    for (const QString& prefix : kColourPrefixes()) {
+        if (base.startsWith(prefix)) { stem = base.mid(prefix.size()); break; }
+    }
+    if (stem.isEmpty()) return {};
+
+    QStringList members;
+    for (const QString& prefix : kColourPrefixes()) {
+        const QString candidate = info.path() + "/" + prefix + stem + "." + info.suffix();
+        QDateTime modified;
+        if (indexedModified(candidate, &modified)) members << candidate;
+    }
+    return members;
+}
+
+} // namespace vision
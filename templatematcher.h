@@ -0,0 +1,454 @@
+#ifndef TEMPLATEMATCHER_H
+#define TEMPLATEMATCHER_H
+
+#include <QString>
+#include <QStringList>
+#include <QImage>
+#include <QHash>
+#include <QList>
+#include <QMutex>
+#include <QDateTime>
+#include <QDeadlineTimer>
+#include <QJsonObject>
+#include <QSet>
+#include <array>
+#include <functional>
+#include <memory>
+#include <vector>
+#include <opencv2/core.hpp>
+
+namespace vision {
+
+// 匹配策略
+enum class MatchStrategy {
+    Ncc,        // 彩色 NCC（默认，等价于 TM_CCOEFF_NORMED）
+    Edge,       // 二值边缘图 + XOR/popcount，适合标题、文字等形状重于颜色的模板
+    Sad,        // 逐像素绝对差之和 + 逐行提前终止，适合 Flash 原样渲染的静态按钮；超出容差回退 NCC
+    Pyramid     // 先在 1/2 分辨率上粗匹配，再只在候选附近做全分辨率 NCC，适合大模板
+};
+
+QString strategyToString(MatchStrategy s);
+MatchStrategy stringToStrategy(const QString& str);
+
+// 每个模板的元数据（决定匹配方式等）
+// 持久化在模板所在目录的 templates.json 清单中，以文件名为键；只写出非默认值
+struct TemplateMeta {
+    MatchStrategy strategy = MatchStrategy::Ncc;
+    double sadTolerance = 4.0;  // Sad 策略：允许的平均每字节绝对差 (0-255)
+    bool manual = false;        // 策略由人工指定，自动调优不再改动
+    qint64 tunedFor = 0;        // 自动调优时模板文件的修改时间 (ms)；与当前不一致则重新调优
+    double speedup = 1.0;       // 自动调优测得的相对整帧 NCC 加速比
+
+    double threshold = 0.0;     // > 0 时覆盖调用方传入的阈值
+    cv::Rect roiHint;           // 目标通常出现的区域（帧像素坐标），优先搜索
+    double scale = 1.0;         // 模板相对当前画面的缩放（截图分辨率与运行时不同时使用）
+    bool useMask = false;       // 以 PNG 的 alpha 通道为掩码，透明像素不参与匹配
+    QString family;             // 显式模板族名：同目录下族名相同的模板组成一族（优先于颜色前缀约定）
+    quint64 contentHash = 0;    // 文件内容的 xxHash64；只有内容真正变化才重新调优
+
+    QJsonObject toJson() const;
+    static TemplateMeta fromJson(const QJsonObject& json);
+};
+
+// 按位打包的二值边缘图
+// 每行按 64 位字存储，bit x 位于第 x/64 个字的第 x%64 位；行尾额外留出填充字
+struct EdgeMap {
+    int width = 0;
+    int height = 0;
+    int wordsPerRow = 0;
+    std::vector<quint64> bits;
+    cv::Mat count;              // 边缘像素积分图 (h+1)x(w+1)，CV_32S
+
+    const quint64* row(int y) const { return bits.data() + static_cast<size_t>(y) * wordsPerRow; }
+    bool empty() const { return bits.empty(); }
+
+    static EdgeMap build(const cv::Mat& bgr);
+};
+
+// 整帧感知哈希（dHash）：缩到 17x16 亮度图，比较水平相邻像素得到 256 位
+// 用汉明距离衡量两帧画面是否为同一界面，对小范围动画、数字变化不敏感
+struct SceneHash {
+    std::array<quint64, 4> bits{};
+    bool valid = false;
+
+    static SceneHash compute(const cv::Mat& gray);
+    int distance(const SceneHash& other) const;
+};
+
+// 一帧截图
+// 持有 BGR 像素，并按需计算可被该帧上所有模板共享的统计量（浮点图、积分图）
+class Frame {
+public:
+    explicit Frame(cv::Mat bgr) : bgr_(std::move(bgr)) {}
+
+    // 从 QImage（RGB32/ARGB32）构造，失败返回 nullptr
+    static std::shared_ptr<Frame> fromImage(const QImage& img);
+
+    const cv::Mat& bgr() const { return bgr_; }
+    int width() const { return bgr_.cols; }
+    int height() const { return bgr_.rows; }
+    bool empty() const { return bgr_.empty(); }
+
+    // CV_32FC3，用于与零均值模板做互相关
+    const cv::Mat& bgrF() const;
+
+    // 积分图 (h+1)x(w+1)，CV_64FC3：像素和 / 像素平方和
+    const cv::Mat& integralSum() const;
+    const cv::Mat& integralSqSum() const;
+
+    // 二值边缘图（Edge 策略使用）
+    const EdgeMap& edges() const;
+
+    // 亮度平面：CV_8UC1 / CV_32FC1 及其积分图（模板族的共享形状模板使用）
+    const cv::Mat& gray() const;
+    const cv::Mat& grayF() const;
+    const cv::Mat& grayIntegralSum() const;
+    const cv::Mat& grayIntegralSqSum() const;
+
+    // 整帧感知哈希（场景识别使用）
+    const SceneHash& sceneHash() const;
+
+    // 像素内容哈希：隔行抽样的 xxHash64（含尺寸），用于识别“画面完全没变”
+    quint64 contentHash() const;
+
+    // 1/2 分辨率的帧（pyrDown），粗匹配使用
+    const Frame& coarse() const;
+
+private:
+    void ensureIntegrals() const;
+    void ensureGrayIntegrals() const;
+
+    cv::Mat bgr_;
+    mutable cv::Mat bgrF_;
+    mutable cv::Mat sum_;
+    mutable cv::Mat sqsum_;
+    mutable EdgeMap edges_;
+    mutable cv::Mat gray_;
+    mutable cv::Mat grayF_;
+    mutable cv::Mat graySum_;
+    mutable cv::Mat graySqSum_;
+    mutable SceneHash sceneHash_;
+    mutable quint64 contentHash_ = 0;
+    mutable bool hasContentHash_ = false;
+    mutable std::shared_ptr<Frame> coarse_;
+};
+
+// 预编译模板：加载时一次性计算好 NCC 所需的全部模板侧统计量
+// 注册表按内容寻址：内容与编译参数都相同的多个文件共享像素与统计量，每个文件拿到带自己 path/modified 的浅拷贝
+struct CompiledTemplate {
+    QString path;
+    QDateTime modified;         // 文件修改时间，用于检测模板被重新截图
+    quint64 contentHash = 0;    // 文件内容的 xxHash64
+    QString blobKey;            // 内容哈希 + 预处理参数，可用作跨文件共享的缓存键（不含阈值、ROI）
+    cv::Mat bgr;                // CV_8UC3 原图（来自模板包时指向只读映射，见 fromPlanes）
+    cv::Mat zeroMean;           // CV_32FC3，逐通道减去均值后的像素
+    cv::Scalar channelSum;      // 逐通道像素和
+    double norm = 0.0;          // sqrt(Σ zeroMean²)
+    TemplateMeta meta;
+
+    // Edge 策略：按 0..63 位偏移预先移位的模板行与掩码，匹配时与帧按字对齐直接 XOR
+    struct ShiftedEdges {
+        int words = 0;                  // 每行字数
+        std::vector<quint64> bits;      // height * words
+        std::vector<quint64> mask;      // words
+    };
+    std::vector<ShiftedEdges> edgeShifts;   // 64 个偏移
+    int edgeCount = 0;                      // 模板边缘像素数
+
+    // 1/2 分辨率模板（粗匹配使用）；模板太小时为空
+    std::shared_ptr<const CompiledTemplate> coarse;
+
+    // 掩码（CV_8UC1，非 0 为参与匹配的像素）；为空表示不使用掩码。带掩码的模板总是走掩码 NCC
+    cv::Mat mask;
+
+    // 按文件元数据（阈值、ROI）派生的浅拷贝指向共享的编译结果，保证其在注册表中存活
+    std::shared_ptr<const CompiledTemplate> shared;
+
+    int width() const { return bgr.cols; }
+    int height() const { return bgr.rows; }
+    int area() const { return bgr.cols * bgr.rows; }
+    bool empty() const { return bgr.empty(); }
+
+    // bgr 为原始尺寸的图片，按 meta.scale 缩放后编译
+    static std::shared_ptr<CompiledTemplate> compile(const QString& path, const cv::Mat& bgr,
+                                                     const TemplateMeta& meta = TemplateMeta(),
+                                                     const cv::Mat& mask = cv::Mat());
+
+    // 预先算好的一层像素与统计量
+    struct Planes {
+        cv::Mat bgr;            // CV_8UC3
+        cv::Mat zeroMean;       // CV_32FC3
+        cv::Scalar channelSum;
+        double norm = 0.0;
+    };
+    // 由预先算好的平面直接组装，不复制像素（模板包使用，平面指向只读映射内存）；
+    // 只适用于 scale == 1 且不使用掩码的元数据。
+    // cv::Mat 没有只读形式：这些平面只能读取，原地写入会访问冲突，需要可写像素时先 clone()
+    static std::shared_ptr<CompiledTemplate> fromPlanes(const QString& path, const Planes& full,
+                                                        const Planes* coarse, const TemplateMeta& meta);
+};
+
+// 模板清单中的阈值优先于调用方阈值
+inline double effectiveThreshold(const CompiledTemplate& tpl, double threshold) {
+    return tpl.meta.threshold > 0.0 ? tpl.meta.threshold : threshold;
+}
+
+// 多目标搜索区域（帧像素坐标）：调用方给定的 roi 优先，否则取模板清单中的区域；都没有时为空（全帧）
+inline cv::Rect searchArea(const CompiledTemplate& tpl, const cv::Rect& roi = cv::Rect()) {
+    return roi.area() > 0 ? roi : tpl.meta.roiHint;
+}
+
+// 颜色变体模板族（如 绿色帜/蓝色帜/紫色帜）
+// 所有变体共享一个亮度形状模板，命中后再用色相直方图判定是哪一个变体，
+// 最后只在命中点附近用该变体自身的模板确认
+struct TemplateFamily {
+    QString name;
+    QStringList members;                // 变体模板路径
+    cv::Mat gray;                       // CV_8UC1 共享亮度模板（各变体居中裁到公共尺寸后的亮度均值）
+    cv::Mat zeroMean;                   // CV_32FC1
+    double norm = 0.0;
+    std::vector<cv::Point> cropOffsets; // 公共区域在各变体模板内的左上角
+    std::vector<cv::Mat> hueHists;      // 每个变体的归一化色相直方图
+    std::vector<std::shared_ptr<const CompiledTemplate>> sources;   // 变体模板（亦用于检测成员被修改）
+
+    int width() const { return gray.cols; }
+    int height() const { return gray.rows; }
+    bool empty() const { return gray.empty() || members.isEmpty(); }
+
+    static std::shared_ptr<TemplateFamily> compile(const QString& name,
+                                                   const std::vector<std::shared_ptr<const CompiledTemplate>>& members);
+};
+
+// 单次匹配结果（帧像素坐标）
+struct Hit {
+    bool found = false;
+    cv::Point topLeft;
+    cv::Size size;
+    double score = 0.0;
+    int tag = 0;                // 调用方自定义标记（如合并多个模板的结果时记录模板序号）
+
+    cv::Point center() const { return cv::Point(topLeft.x + size.width / 2, topLeft.y + size.height / 2); }
+};
+
+// 多目标结果的排序方式
+enum class HitOrder {
+    Position,   // 从上到下、从左到右（同一行内按 x）
+    Score       // 得分从高到低
+};
+
+// NCC 结果图（等价于 TM_CCOEFF_NORMED），search 为帧内的搜索区域（空则全帧）
+// 返回的结果图左上角对应 search 的左上角
+cv::Mat nccMap(const Frame& frame, const CompiledTemplate& tpl, const cv::Rect& search = cv::Rect());
+
+// 在 search 区域内取 NCC 全局最大值；found 表示 score >= threshold
+Hit matchNcc(const Frame& frame, const CompiledTemplate& tpl, double threshold,
+             const cv::Rect& search = cv::Rect());
+
+// 二值边缘图匹配：XOR+popcount 求汉明距离，再换算为二值相关系数（phi），
+// 与 NCC 同为 [-1, 1] 的相关系数，阈值含义保持一致
+Hit matchEdge(const Frame& frame, const CompiledTemplate& tpl, double threshold,
+              const cv::Rect& search = cv::Rect());
+
+// 精确像素匹配：SAD 超过 tolerance（平均每字节绝对差）的窗口逐行提前放弃
+// 命中时 score = 1 - 平均绝对差/255
+Hit matchSad(const Frame& frame, const CompiledTemplate& tpl, double tolerance, double threshold,
+             const cv::Rect& search = cv::Rect());
+
+// 模板族匹配结果：variant 为命中的变体序号（-1 表示未命中）
+struct FamilyHit {
+    Hit hit;
+    int variant = -1;
+    QString variantPath;
+    double colourDistance = 1.0;    // 与命中变体色相直方图的 Bhattacharyya 距离
+};
+
+// 一次亮度 NCC 找到形状（阈值放宽），在命中区域按色相分类，再用该变体模板在附近小范围确认；
+// 最近的变体确认不了时按颜色距离依次确认其余变体。返回的 hit 为确认后的变体位置与得分
+FamilyHit matchFamily(const Frame& frame, const TemplateFamily& family, double threshold,
+                      const cv::Rect& search = cv::Rect());
+
+// 多目标匹配：从同一张 NCC 结果图中取出所有 >= threshold 的局部峰值，
+// 经非极大值抑制（IoU > maxOverlap 的较低者被去掉）后最多保留 maxCount 个。
+// 模板策略不是 NCC 时峰值只作候选，每个候选再按模板策略（同 match）在附近确认
+std::vector<Hit> matchAll(const Frame& frame, const CompiledTemplate& tpl, double threshold,
+                          int maxCount, HitOrder order = HitOrder::Position,
+                          double maxOverlap = 0.3, const cv::Rect& search = cv::Rect());
+
+// 非极大值抑制（按得分贪心），可用于合并多个模板的 matchAll 结果
+std::vector<Hit> suppressOverlaps(std::vector<Hit> hits, double maxOverlap, int maxCount);
+void sortHits(std::vector<Hit>& hits, HitOrder order);
+
+// 金字塔匹配：1/2 分辨率上取若干候选峰，再在候选附近做全分辨率 NCC；无粗模板时退化为 matchNcc
+Hit matchPyramid(const Frame& frame, const CompiledTemplate& tpl, double threshold,
+                 const cv::Rect& search = cv::Rect());
+
+// 可随时中断的匹配预算
+struct MatchBudget {
+    QDeadlineTimer deadline;                // 默认永不过期
+    std::function<bool()> cancelled;        // 每个分块之间检查（如 StopToken）
+    cv::Point prior = cv::Point(-1, -1);    // 上次命中的左上角，优先搜索其所在分块
+    cv::Rect roiHint;                       // 可能出现的区域，优先搜索
+};
+
+// 随时可返回的 NCC：结果图按分块计算，先算最可能的分块（上次命中位置、ROI 提示、粗匹配得分高的分块），
+// 每块之间检查截止时间与取消；到时返回目前为止的最佳结果，complete 为 false。
+// result 非空时输出全帧结果图（未计算的位置为 -1）
+Hit matchAnytime(const Frame& frame, const CompiledTemplate& tpl, double threshold,
+                 const MatchBudget& budget, bool* complete = nullptr, cv::Mat* result = nullptr);
+
+// 按模板元数据选择策略进行匹配
+Hit match(const Frame& frame, const CompiledTemplate& tpl, double threshold,
+          const cv::Rect& search = cv::Rect());
+
+// 两帧在 region 内的平均每字节绝对差 (0-255)；用于判断点击后局部画面是否发生变化
+double regionDifference(const Frame& a, const Frame& b, const cv::Rect& region);
+
+// 增量匹配器（每个窗口一份，不跨线程共享）
+// 为每个模板保留上次的 NCC 结果图及当时的画面；新帧到来时按块比较两帧，
+// 只重算与变化块重叠的窗口位置，其余位置沿用旧结果。变化面积超过阈值、
+// 帧尺寸变化或模板被重新编译时整帧重扫。仅用于 Ncc 策略的全帧匹配，其他情况直接调用 match()
+class IncrementalMatcher {
+public:
+    explicit IncrementalMatcher(int blockSize = 32, double fullRescanRatio = 0.35, int maxTemplates = 16)
+        : blockSize_(blockSize), fullRescanRatio_(fullRescanRatio), maxTemplates_(maxTemplates) {}
+
+    // budget 仅作用于整帧重扫：重扫未在预算内完成时返回目前最佳结果，且不保留不完整的结果图；
+    // 此时 complete 为 false，结果不代表整帧，调用方不应缓存
+    Hit match(const Frame& frame, const std::shared_ptr<const CompiledTemplate>& tpl, double threshold,
+              const MatchBudget* budget = nullptr, bool* complete = nullptr);
+    void clear();
+
+    quint64 partialUpdates() const { return partialUpdates_; }
+    quint64 fullScans() const { return fullScans_; }
+
+private:
+    struct Entry {
+        std::shared_ptr<const CompiledTemplate> tpl;
+        cv::Mat bgr;        // 计算 result 时的画面（与帧共享像素数据）
+        cv::Mat result;     // 全帧 NCC 结果图
+        cv::Point lastHit = cv::Point(-1, -1);  // 上次最佳位置（预算匹配时优先搜索）
+    };
+
+    // 两帧之间的变化块，按行合并为矩形（帧像素坐标）
+    std::vector<cv::Rect> dirtyRects(const cv::Mat& before, const cv::Mat& after) const;
+    // 同一对画面只比较一次：一次轮询里各模板通常对着同一前后两帧，共用变化块
+    const std::vector<cv::Rect>& dirtyRectsCached(const cv::Mat& before, const cv::Mat& after);
+
+    int blockSize_;
+    double fullRescanRatio_;
+    int maxTemplates_;
+    QHash<QString, Entry> entries_;
+    QList<QString> order_;      // 最近使用的模板在末尾
+    cv::Mat dirtyBefore_;       // 上次计算变化块的前后画面（持有引用，像素地址不会被复用）
+    cv::Mat dirtyAfter_;
+    std::vector<cv::Rect> dirty_;
+    quint64 partialUpdates_ = 0;
+    quint64 fullScans_ = 0;
+};
+
+// xxHash64
+quint64 xxhash64(const void* data, size_t len, quint64 seed = 0);
+
+// 匹配结果备忘（每个窗口一份，不跨线程共享）
+// 以 (帧内容哈希, 调用方给定的键) 缓存匹配结果：静止画面上的重复轮询直接复用，不再调用 matchTemplate。
+// 只保留最近 frames 个不同画面的结果
+class MatchMemo {
+public:
+    explicit MatchMemo(int frames = 4) : capacity_(frames) {}
+
+    bool lookup(quint64 frameHash, const QString& key, Hit* out);
+    void store(quint64 frameHash, const QString& key, const Hit& hit);
+    void clear();
+
+    quint64 saved() const { return saved_; }    // 命中备忘（省掉的匹配）次数
+
+private:
+    int capacity_;
+    QList<quint64> order_;                      // 最近使用的画面在末尾
+    QHash<quint64, QHash<QString, Hit>> entries_;
+    quint64 saved_ = 0;
+};
+
+// 读图：支持资源路径和中文文件路径
+cv::Mat imreadSafe(const QString& filePath, int flags);
+
+// 模板注册表（进程内共享，线程安全）
+// 每个模板只解码、预计算一次；文件被覆盖（重新截图）后自动重新编译。
+// 已编译模板以内容哈希寻址：不同任务目录中内容相同的图片共享同一份像素、统计量与匹配先验
+class TemplateRegistry {
+public:
+    static TemplateRegistry& instance();
+
+    // 获取预编译模板，加载失败返回 nullptr
+    std::shared_ptr<const CompiledTemplate> get(const QString& path);
+
+    // 文件被重新保存后调用：该模板与所在目录的文件索引、模板族都重新读取
+    void invalidate(const QString& path);
+    void clear();
+    // 丢弃全部目录索引与模板族成员（目录中增删、覆盖了图片时），下次访问时重新扫描
+    void reload();
+
+    // 并行加载、编译一批模板（阻塞至全部完成），返回不存在的文件；
+    // 涉及的目录先重新扫描一次。路径写法需与之后匹配时传入的一致，缓存按传入的路径命中
+    QStringList prefetch(const QStringList& paths);
+
+    // 已加载模板中内容相同的文件组
+    QList<QStringList> duplicates();
+    // 扫描 root 下全部 png，返回内容相同的文件组（不加载进注册表）
+    static QList<QStringList> findDuplicates(const QString& root);
+
+    // 模板元数据（首次访问某目录时从其 templates.json 清单读入）；修改后写回清单，模板按新元数据重新编译
+    TemplateMeta meta(const QString& path);
+    void setMeta(const QString& path, const TemplateMeta& meta);
+
+    // 模板首次加载或文件变化后自动调优策略（默认开启）
+    void setAutoTune(bool enabled);
+
+    // 按成员列表获取（编译）模板族；任一成员加载失败返回 nullptr
+    std::shared_ptr<const TemplateFamily> family(const QStringList& members);
+
+    // 查找 path 所属的模板族：清单中指定了族名时取同目录下同族的模板，
+    // 否则按命名约定取同目录下仅颜色前缀不同的图片（绿色X / 蓝色X / 紫色X …）
+    std::shared_ptr<const TemplateFamily> familyOf(const QString& path);
+
+private:
+    TemplateRegistry() = default;
+
+    // 以下两个函数要求已持有 mutex_
+    QStringList conventionFamilyMembers(const QString& path);
+    QStringList manifestFamilyMembers(const QString& path, const QString& family);
+
+    // 只更新内存中的元数据（加载时算出的内容哈希等），不写清单
+    void rememberMeta(const QString& path, const TemplateMeta& meta);
+    // 写入元数据并保存清单，不使已编译的模板失效
+    void storeMeta(const QString& path, const TemplateMeta& meta);
+    // 从内容相同且已调优的其他文件沿用策略
+    bool adoptTuning(const QString& path, TemplateMeta* m);
+
+    struct CacheEntry {
+        QDateTime modified;
+        std::shared_ptr<const CompiledTemplate> tpl;
+    };
+
+    // 以下函数要求已持有 mutex_
+    void ensureFolderLoaded(const QString& folder);
+    void saveFolder(const QString& folder);
+    // 目录内 png 的修改时间，每个目录只列一次；轮询时不再逐个 stat。文件不存在返回 false
+    bool indexedModified(const QString& path, QDateTime* modified);
+    void dropFolderIndex(const QString& folder);
+
+    QMutex mutex_;
+    QSet<QString> loadedFolders_;
+    bool autoTune_ = true;
+    QHash<QString, CacheEntry> cache_;                                  // key: 调用方传入的路径
+    QHash<QString, std::weak_ptr<const CompiledTemplate>> blobs_;       // key: CompiledTemplate::blobKey
+    QHash<quint64, QStringList> contentPaths_;                          // 内容哈希 -> 已加载的绝对路径
+    QHash<QString, TemplateMeta> meta_;                                 // key: 模板绝对路径
+    QHash<QString, std::shared_ptr<const TemplateFamily>> families_;    // key: 成员路径以 | 连接
+    QHash<QString, QHash<QString, QDateTime>> folderIndex_;             // 目录绝对路径 -> 文件名 -> 修改时间
+    QHash<QString, QStringList> familyMembers_;                         // key: 模板绝对路径，所属族的成员
+};
+
+} // namespace vision
+
+#endif // TEMPLATEMATCHER_H
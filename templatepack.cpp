@@ -0,0 +1,234 @@
+#include "templatepack.h"
+
+#include <QDir>
+#include <QDirIterator>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QJsonArray>
+#include <QDebug>
+#include <QCoreApplication>
+#include <opencv2/imgcodecs.hpp>
+#include <cstring>
+
+namespace vision {
+
+static const char kPackMagic[8] = {'H', 'J', 'D', 'Z', 'T', 'P', 'K', '1'};
+static const quint32 kPackVersion = 1;
+static const qint64 kPackAlign = 64;
+
+struct PackHeader {
+    char magic[8];
+    quint32 version;
+    quint32 count;
+    quint64 indexOffset;
+    quint64 indexSize;
+    char reserved[32];
+};
+static_assert(sizeof(PackHeader) == 64, "pack header must stay 64 bytes");
+
+TemplatePack& TemplatePack::instance() {
+    static TemplatePack pack;
+    return pack;
+}
+
+QString TemplatePack::defaultRoot() {
+    const QString appRoot = QCoreApplication::applicationDirPath() + "/游戏图片";
+    if (QDir(appRoot).exists()) return appRoot;
+    return QDir("游戏图片").absolutePath();
+}
+
+QString TemplatePack::defaultPath() {
+    return defaultRoot() + "/templates.pack";
+}
+
+void TemplatePack::ensureOpen() {
+    // 调用方已持有 mutex_
+    if (opened_) return;
+    opened_ = true;
+
+    const QString path = defaultPath();
+    // 上次运行时生成的新包：替换旧包后再映射
+    if (QFile::exists(path + ".new")) {
+        if (QFile::exists(path) && !QFile::remove(path)) {
+            // 旧包仍被占用（如另一个进程映射着）：本次继续用旧包，新包留到下次启动再替换
+            qWarning() << "[TemplatePack] cannot remove old pack" << path << "- keeping" << path + ".new";
+        } else if (!QFile::rename(path + ".new", path)) {
+            qWarning() << "[TemplatePack] cannot replace pack with" << path + ".new";
+        }
+    }
+    if (QFile::exists(path) && open(defaultRoot(), path)) {
+        qDebug() << "[TemplatePack] mapped" << entries_.size() << "templates from" << path;
+    }
+}
+
+// 只读映射内的一个平面；越界或尺寸不合法返回空 Mat
+static cv::Mat planeAt(const uchar* data, qint64 mapped, const QJsonObject& json, const char* key, int type) {
+    const int w = json["w"].toInt();
+    const int h = json["h"].toInt();
+    const qint64 offset = static_cast<qint64>(json[key].toDouble(-1));
+    if (w <= 0 || h <= 0 || offset < 0 || offset % kPackAlign != 0) return {};
+    const qint64 bytes = static_cast<qint64>(w) * h * CV_ELEM_SIZE(type);
+    if (offset + bytes > mapped) return {};
+    // cv::Mat 只有可写的构造：返回的平面仍指向只读映射，只能读取（见 CompiledTemplate::fromPlanes）
+    return cv::Mat(h, w, type, const_cast<uchar*>(data + offset));
+}
+
+static bool readPlanes(const uchar* data, qint64 mapped, const QJsonObject& json, CompiledTemplate::Planes* out) {
+    out->bgr = planeAt(data, mapped, json, "bgr", CV_8UC3);
+    out->zeroMean = planeAt(data, mapped, json, "zero_mean", CV_32FC3);
+    const QJsonArray sum = json["sum"].toArray();
+    if (out->bgr.empty() || out->zeroMean.empty() || sum.size() != 3) return false;
+    out->channelSum = cv::Scalar(sum[0].toDouble(), sum[1].toDouble(), sum[2].toDouble());
+    out->norm = json["norm"].toDouble();
+    return true;
+}
+
+bool TemplatePack::open(const QString& root, const QString& packPath) {
+    file_.setFileName(packPath);
+    if (!file_.open(QIODevice::ReadOnly)) return false;
+    mapped_ = file_.size();
+    if (mapped_ < static_cast<qint64>(sizeof(PackHeader))) return false;
+    data_ = file_.map(0, mapped_);
+    if (!data_) {
+        qWarning() << "[TemplatePack] map failed:" << file_.errorString();
+        return false;
+    }
+
+    PackHeader header;
+    std::memcpy(&header, data_, sizeof(header));
+    if (std::memcmp(header.magic, kPackMagic, sizeof(kPackMagic)) != 0 || header.version != kPackVersion ||
+        header.indexOffset + header.indexSize > static_cast<quint64>(mapped_)) {
+        qWarning() << "[TemplatePack] unsupported or truncated pack:" << packPath;
+        return false;
+    }
+
+    const QByteArray indexBytes = QByteArray::fromRawData(reinterpret_cast<const char*>(data_ + header.indexOffset),
+                                                          static_cast<int>(header.indexSize));
+    const QJsonArray index = QJsonDocument::fromJson(indexBytes).object()["templates"].toArray();
+    for (const QJsonValue& v : index) {
+        const QJsonObject json = v.toObject();
+        Entry e;
+        e.relPath = json["path"].toString();
+        e.mtime = json["mtime"].toString().toLongLong();
+        e.size = json["size"].toString().toLongLong();
+        e.hash = json["hash"].toString().toULongLong(nullptr, 16);
+        if (e.relPath.isEmpty() || !readPlanes(data_, mapped_, json["full"].toObject(), &e.full)) continue;
+        e.hasCoarse = json.contains("coarse") && readPlanes(data_, mapped_, json["coarse"].toObject(), &e.coarse);
+        entries_.insert(e.relPath, e);
+    }
+    root_ = QDir(root).absolutePath();
+    return true;
+}
+
+const TemplatePack::Entry* TemplatePack::lookup(const QFileInfo& file) {
+    QMutexLocker lock(&mutex_);
+    ensureOpen();
+    if (entries_.isEmpty()) return nullptr;
+
+    const QString rel = QDir(root_).relativeFilePath(file.absoluteFilePath());
+    if (rel.startsWith("..")) return nullptr;
+    auto it = entries_.constFind(rel);
+    if (it == entries_.constEnd()) return nullptr;
+
+    // 原图被重新截图/替换后包内数据过期，交给散装 PNG
+    if (it.value().size != file.size() || it.value().mtime != file.lastModified().toMSecsSinceEpoch()) {
+        return nullptr;
+    }
+    return &it.value();
+}
+
+int TemplatePack::count() {
+    QMutexLocker lock(&mutex_);
+    ensureOpen();
+    return entries_.size();
+}
+
+// 写到下一个对齐位置，返回该位置
+static qint64 writeAligned(QFile& out, const cv::Mat& mat) {
+    qint64 pos = out.pos();
+    const qint64 pad = (kPackAlign - pos % kPackAlign) % kPackAlign;
+    if (pad > 0) out.write(QByteArray(static_cast<int>(pad), '\0'));
+    pos += pad;
+    const cv::Mat m = mat.isContinuous() ? mat : mat.clone();
+    out.write(reinterpret_cast<const char*>(m.data), static_cast<qint64>(m.total() * m.elemSize()));
+    return pos;
+}
+
+static QJsonObject writePlanes(QFile& out, const CompiledTemplate& t) {
+    QJsonObject json;
+    json["w"] = t.width();
+    json["h"] = t.height();
+    json["bgr"] = static_cast<double>(writeAligned(out, t.bgr));
+    json["zero_mean"] = static_cast<double>(writeAligned(out, t.zeroMean));
+    json["sum"] = QJsonArray{t.channelSum[0], t.channelSum[1], t.channelSum[2]};
+    json["norm"] = t.norm;
+    return json;
+}
+
+int TemplatePack::build(const QString& root, const QString& packPath, QString* error) {
+    // 写到临时文件，完成后再替换；本进程正映射着目标文件时留待下次启动替换
+    const QString tmpPath = packPath + ".new";
+    QFile out(tmpPath);
+    if (!out.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        if (error) *error = out.errorString();
+        return -1;
+    }
+    out.write(QByteArray(sizeof(PackHeader), '\0'));
+
+    const QDir rootDir(root);
+    QJsonArray index;
+    QDirIterator it(root, QStringList() << "*.png", QDir::Files, QDirIterator::Subdirectories);
+    while (it.hasNext()) {
+        const QString path = it.next();
+        const QFileInfo info(path);
+        const QString rel = rootDir.relativeFilePath(info.absoluteFilePath());
+        if (rel.startsWith(QStringLiteral("场景参考/"))) continue;   // 整帧截图不是模板
+        QFile file(path);
+        if (!file.open(QIODevice::ReadOnly)) continue;
+        const QByteArray bytes = file.readAll();
+        const std::vector<uchar> buf(bytes.begin(), bytes.end());
+        const cv::Mat bgr = cv::imdecode(buf, cv::IMREAD_COLOR);
+        if (bgr.empty()) continue;
+
+        auto tpl = CompiledTemplate::compile(path, bgr);
+        QJsonObject json;
+        json["path"] = rel;
+        json["mtime"] = QString::number(info.lastModified().toMSecsSinceEpoch());
+        json["size"] = QString::number(info.size());
+        json["hash"] = QString::number(xxhash64(bytes.constData(), static_cast<size_t>(bytes.size())), 16);
+        json["full"] = writePlanes(out, *tpl);
+        if (tpl->coarse) json["coarse"] = writePlanes(out, *tpl->coarse);
+        index.append(json);
+    }
+
+    QJsonObject indexRoot;
+    indexRoot["templates"] = index;
+    const QByteArray indexBytes = QJsonDocument(indexRoot).toJson(QJsonDocument::Compact);
+    PackHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, kPackMagic, sizeof(kPackMagic));
+    header.version = kPackVersion;
+    header.count = static_cast<quint32>(index.size());
+    header.indexOffset = static_cast<quint64>(out.pos());
+    header.indexSize = static_cast<quint64>(indexBytes.size());
+    out.write(indexBytes);
+    out.seek(0);
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.close();
+
+    bool mappedHere = false;
+    {
+        TemplatePack& self = instance();
+        QMutexLocker lock(&self.mutex_);
+        mappedHere = self.data_ && QFileInfo(self.file_.fileName()).absoluteFilePath() == QFileInfo(packPath).absoluteFilePath();
+    }
+    if (mappedHere) {
+        if (error) *error = QStringLiteral("模板包正在使用");
+    } else {
+        QFile::remove(packPath);
+        if (!QFile::rename(tmpPath, packPath) && error) *error = QStringLiteral("无法替换 %1").arg(packPath);
+    }
+    return index.size();
+}
+
+} // namespace vision
@@ -0,0 +1,63 @@
+#ifndef TEMPLATEPACK_H
+#define TEMPLATEPACK_H
+
+#include "templatematcher.h"
+
+#include <QString>
+#include <QHash>
+#include <QFile>
+#include <QFileInfo>
+#include <QMutex>
+
+namespace vision {
+
+// 预编译模板包（游戏图片/templates.pack）
+// 把 游戏图片/ 下全部模板预先解码、算好 NCC 统计量与 1/2 分辨率层，按 64 字节对齐写进一个文件；
+// 运行时只读映射（QFile::map），模板像素直接指向映射内存，多个窗口/进程共享同一份物理页。
+// 包内每个条目记录原图的修改时间与大小，对不上（重新截图过）时该模板回退到读取散装 PNG。
+//
+// 文件格式：64 字节文件头 | 各平面数据 | JSON 索引
+class TemplatePack {
+public:
+    struct Entry {
+        QString relPath;                // 相对包根目录，'/' 分隔
+        qint64 mtime = 0;               // 原图修改时间 (ms)
+        qint64 size = 0;                // 原图字节数
+        quint64 hash = 0;               // 原图内容的 xxHash64
+        CompiledTemplate::Planes full;
+        CompiledTemplate::Planes coarse;
+        bool hasCoarse = false;
+    };
+
+    // 首次调用时映射默认位置的包；包不存在或格式不对时 lookup 总是返回 nullptr
+    static TemplatePack& instance();
+
+    // 查找 file 对应的条目；不在包中或原图已变化返回 nullptr
+    const Entry* lookup(const QFileInfo& file);
+
+    int count();
+
+    static QString defaultRoot();
+    static QString defaultPath();
+
+    // 编译 root 下全部 png 写成包；返回写入的模板数，失败返回 -1。
+    // 目标文件正被本进程映射时写到 <packPath>.new，下次启动时替换
+    static int build(const QString& root, const QString& packPath, QString* error = nullptr);
+
+private:
+    TemplatePack() = default;
+    void ensureOpen();
+    bool open(const QString& root, const QString& packPath);
+
+    QMutex mutex_;
+    bool opened_ = false;
+    QFile file_;
+    uchar* data_ = nullptr;             // 只读映射，进程结束前不解除（模板 Mat 引用其中的像素）
+    qint64 mapped_ = 0;
+    QString root_;
+    QHash<QString, Entry> entries_;
+};
+
+} // namespace vision
+
+#endif // TEMPLATEPACK_H
@@ -0,0 +1,195 @@
+#include "templatetuner.h"
+
+#include <QDir>
+#include <QFileInfo>
+#include <QDebug>
+#include <QCoreApplication>
+#include <opencv2/imgcodecs.hpp>
+#include <cmath>
+
+namespace vision {
+
+static const int kMaxSamples = 12;          // 最多保留的样本帧
+static const int kSampleIntervalMs = 5000;  // 运行中截图的采样间隔
+static const double kTuneThreshold = 0.85;  // 对照时使用的匹配阈值（与脚本默认一致；清单中有阈值时用清单的）
+static const int kPositionSlack = 2;        // 命中位置允许的偏差（像素）
+static const double kMinSpeedup = 1.2;      // 至少快这么多才替换 NCC，避免计时噪声导致来回切换
+static const int kTimingRounds = 2;
+
+TemplateTuner& TemplateTuner::instance() {
+    static TemplateTuner tuner;
+    return tuner;
+}
+
+TemplateTuner::TemplateTuner() {
+    // 调优只在后台慢慢做，不与匹配线程抢占 CPU
+    pool_.setMaxThreadCount(1);
+}
+
+void TemplateTuner::addSample(const Frame& frame) {
+    if (frame.empty()) return;
+    {
+        QMutexLocker lock(&mutex_);
+        if (lastSample_.isValid() && lastSample_.elapsed() < kSampleIntervalMs) return;
+        lastSample_.start();
+    }
+    const quint64 hash = frame.contentHash();
+
+    QMutexLocker lock(&mutex_);
+    if (sampleHashes_.contains(hash)) return;
+    sampleHashes_.insert(hash);
+    // 新建 Frame 共享像素（只读），帧统计量在调优线程里各自计算
+    samples_.push_back(std::make_shared<Frame>(frame.bgr()));
+    if (static_cast<int>(samples_.size()) > kMaxSamples) {
+        sampleHashes_.remove(samples_.front()->contentHash());
+        samples_.erase(samples_.begin());
+    }
+}
+
+void TemplateTuner::ensureReferenceSamples() {
+    {
+        QMutexLocker lock(&mutex_);
+        if (referencesLoaded_) return;
+        referencesLoaded_ = true;
+    }
+    QDir root(QCoreApplication::applicationDirPath() + "/游戏图片/场景参考");
+    if (!root.exists()) root = QDir("游戏图片/场景参考");
+    if (!root.exists()) return;
+
+    std::vector<std::shared_ptr<const Frame>> loaded;
+    for (const QString& scene : root.entryList(QDir::Dirs | QDir::NoDotAndDotDot)) {
+        QDir sceneDir(root.filePath(scene));
+        for (const QString& file : sceneDir.entryList(QStringList() << "*.png", QDir::Files)) {
+            cv::Mat bgr = imreadSafe(sceneDir.filePath(file), cv::IMREAD_COLOR);
+            if (!bgr.empty()) loaded.push_back(std::make_shared<Frame>(bgr));
+        }
+    }
+
+    QMutexLocker lock(&mutex_);
+    for (const auto& f : loaded) {
+        if (static_cast<int>(samples_.size()) >= kMaxSamples) break;
+        const quint64 hash = f->contentHash();
+        if (sampleHashes_.contains(hash)) continue;
+        sampleHashes_.insert(hash);
+        samples_.push_back(f);
+    }
+}
+
+std::vector<std::shared_ptr<const Frame>> TemplateTuner::samples() {
+    ensureReferenceSamples();
+    QMutexLocker lock(&mutex_);
+    return samples_;
+}
+
+void TemplateTuner::schedule(const QString& path) {
+    const QFileInfo info(path);
+    const QString key = info.absoluteFilePath();
+    const qint64 stamp = info.lastModified().toMSecsSinceEpoch();
+
+    QMutexLocker lock(&mutex_);
+    if (pending_.contains(key) || tried_.value(key, -1) == stamp) return;
+    pending_.insert(key);
+    pool_.start([this, key]() { tune(key); });
+}
+
+QStringList TemplateTuner::takeReport() {
+    QMutexLocker lock(&mutex_);
+    QStringList lines;
+    for (auto it = report_.constBegin(); it != report_.constEnd(); ++it) {
+        lines << QString("%1: %2").arg(QFileInfo(it.key()).fileName(), it.value());
+    }
+    report_.clear();
+    lines.sort();
+    return lines;
+}
+
+static bool sameDecision(const Hit& a, const Hit& b) {
+    if (a.found != b.found) return false;
+    if (!a.found) return true;
+    return std::abs(a.topLeft.x - b.topLeft.x) <= kPositionSlack &&
+           std::abs(a.topLeft.y - b.topLeft.y) <= kPositionSlack;
+}
+
+void TemplateTuner::tune(const QString& path) {
+    auto finish = [&](qint64 stamp, const QString& line) {
+        QMutexLocker lock(&mutex_);
+        pending_.remove(path);
+        if (stamp >= 0) tried_.insert(path, stamp);
+        if (!line.isEmpty()) report_.insert(path, line);
+    };
+
+    auto& registry = TemplateRegistry::instance();
+    auto base = registry.get(path);
+    if (!base) { finish(-1, QString()); return; }
+    const qint64 stamp = QFileInfo(path).lastModified().toMSecsSinceEpoch();  // base 可能是同内容的其他文件共享的
+
+    TemplateMeta meta = registry.meta(path);
+    if (meta.manual) { finish(stamp, QString("人工指定 %1").arg(strategyToString(meta.strategy))); return; }
+    if (!base->mask.empty()) { finish(stamp, QStringLiteral("掩码模板，固定掩码 NCC")); return; }
+
+    const auto frames = samples();
+    if (frames.empty()) { finish(-1, QString()); return; }  // 没有样本，等下次加载再试
+
+    // 基准：整帧 NCC（各帧的浮点图、积分图先算好，不计入任何策略的耗时）
+    TemplateMeta nccMeta = meta;
+    nccMeta.strategy = MatchStrategy::Ncc;
+    nccMeta.scale = 1.0;    // base->bgr 已按清单缩放过
+    auto ncc = CompiledTemplate::compile(path, base->bgr, nccMeta);
+    const double threshold = effectiveThreshold(*ncc, kTuneThreshold);
+    std::vector<Hit> reference;
+    int positives = 0;
+    for (const auto& f : frames) {
+        f->bgrF(); f->integralSum(); f->edges(); f->coarse().bgrF(); f->coarse().integralSum();
+        reference.push_back(matchNcc(*f, *ncc, threshold));
+        if (reference.back().found) ++positives;
+    }
+
+    auto timeOf = [&](const CompiledTemplate& tpl, bool* agrees) {
+        QElapsedTimer timer;
+        timer.start();
+        for (int round = 0; round < kTimingRounds; ++round) {
+            for (size_t i = 0; i < frames.size(); ++i) {
+                Hit hit = match(*frames[i], tpl, threshold);
+                if (agrees && round == 0 && !sameDecision(hit, reference[i])) *agrees = false;
+            }
+        }
+        return qMax<qint64>(1, timer.nsecsElapsed());
+    };
+
+    // 全部样本都未命中时无法判断各策略能否找到目标：本次运行不再尝试，也不写回，等有命中样本后（下次启动）再调优
+    if (positives == 0) { finish(stamp, QString("样本中均未命中，保持 %1").arg(strategyToString(meta.strategy))); return; }
+
+    const qint64 nccTime = timeOf(*ncc, nullptr);
+    MatchStrategy best = MatchStrategy::Ncc;
+    qint64 bestTime = nccTime;
+    QStringList notes;
+    for (MatchStrategy s : {MatchStrategy::Pyramid, MatchStrategy::Sad, MatchStrategy::Edge}) {
+        TemplateMeta m = nccMeta;
+        m.strategy = s;
+        auto candidate = CompiledTemplate::compile(path, base->bgr, m);
+        bool agrees = true;
+        const qint64 t = timeOf(*candidate, &agrees);
+        notes << QString("%1 x%2%3").arg(strategyToString(s))
+                     .arg(double(nccTime) / t, 0, 'f', 1)
+                     .arg(agrees ? "" : " 不一致");
+        if (agrees && t * kMinSpeedup < bestTime) {
+            best = s;
+            bestTime = t;
+        }
+    }
+
+    meta.strategy = best;
+    meta.tunedFor = stamp;
+    meta.speedup = double(nccTime) / bestTime;
+    registry.setMeta(path, meta);
+
+    const QString line = QString("%1 (x%2, 样本 %3/%4 命中)%5")
+                             .arg(strategyToString(best))
+                             .arg(meta.speedup, 0, 'f', 1)
+                             .arg(positives).arg(frames.size())
+                             .arg("  [" + notes.join(", ") + "]");
+    qInfo().noquote() << "[TemplateTuner]" << QFileInfo(path).fileName() << line;
+    finish(stamp, line);
+}
+
+} // namespace vision
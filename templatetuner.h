@@ -0,0 +1,54 @@
+#ifndef TEMPLATETUNER_H
+#define TEMPLATETUNER_H
+
+#include "templatematcher.h"
+
+#include <QString>
+#include <QStringList>
+#include <QSet>
+#include <QHash>
+#include <QMutex>
+#include <QThreadPool>
+#include <QElapsedTimer>
+#include <memory>
+#include <vector>
+
+namespace vision {
+
+// 模板策略自动调优（进程内共享，线程安全）
+// 模板首次加载或文件变化后，在后台线程里用样本帧（运行中的截图 + 场景参考截图）
+// 逐个试跑各策略，与整帧 NCC 的结果对照：命中/未命中一致、位置相差不超过 2 像素才算“一致”，
+// 在一致的策略中选最快的，写回模板元数据（templates.json）。人工指定（manual）的模板不参与
+class TemplateTuner {
+public:
+    static TemplateTuner& instance();
+
+    // 提供一帧样本（内部限频、按内容去重，最多保留若干帧）
+    void addSample(const Frame& frame);
+
+    // 排队调优某模板；同一模板文件版本只调优一次
+    void schedule(const QString& path);
+
+    // 上次取走之后新完成的调优结果，每行一个模板；取走即清空（任务结束时写入运行日志）
+    QStringList takeReport();
+
+private:
+    TemplateTuner();
+    void ensureReferenceSamples();
+    void tune(const QString& path);
+    std::vector<std::shared_ptr<const Frame>> samples();
+
+    QMutex mutex_;
+    QThreadPool pool_;
+    bool referencesLoaded_ = false;
+    QElapsedTimer lastSample_;
+    std::vector<std::shared_ptr<const Frame>> samples_;
+    QSet<quint64> sampleHashes_;
+    QSet<QString> pending_;
+    QHash<QString, qint64> tried_;      // 模板绝对路径 -> 已调优的文件修改时间
+    QHash<QString, QString> report_;    // 模板绝对路径 -> 结果描述（尚未取走的）
+};
+
+} // namespace vision
+
+#endif // TEMPLATETUNER_H
@@ -0,0 +1,113 @@
+#include <QtTest>
+#include <deque>
+#include "fsm_framework.h"
+
+// 监视者每个 tick 都处理画面（主逻辑一次也不执行）时，状态超时与连续处理上限仍要生效
+class TestFsm : public QObject {
+    Q_OBJECT
+
+private:
+    struct Counters {
+        int work = 0;
+        int error = 0;
+        int handled = 0;
+    };
+
+    // 工作状态超时 timeoutMs（0 不限）、重试上限 maxRetries；弹窗一直在，直到离开工作状态；
+    // 失败后进错误状态，错误状态直接完成
+    static void build(fsm::StateMachine* m, Counters* n, int timeoutMs = 200, int maxRetries = 1000) {
+        auto work = std::make_shared<fsm::State>("工作");
+        work->setOnExecute([n](fsm::Context*) { ++n->work; return fsm::TransitionResult::Success; })
+            .setOnExit([](fsm::Context* c) { c->set("popup", false); return fsm::TransitionResult::Success; })
+            .addTransition(fsm::TransitionResult::Success, "完成")
+            .setTimeout(timeoutMs)
+            .setMaxRetries(maxRetries);
+        auto error = std::make_shared<fsm::State>("错误");
+        error->setOnExecute([n](fsm::Context*) { ++n->error; return fsm::TransitionResult::Completed; });
+
+        m->addState(work);
+        m->addState(error);
+        m->setInitialState("工作");
+        m->setErrorState("错误");
+        m->setCompletedState("完成");
+        m->setLogCallback([](const QString&) {});
+        m->addWatcher(fsm::Watcher("弹窗",
+                                   [](fsm::Context* c) { return c->get<bool>("popup", true); },
+                                   [n](fsm::Context*) { ++n->handled; return fsm::TransitionResult::Success; },
+                                   QString(), 20));
+    }
+
+    // 在本线程上按顺序执行的调度器代替事件循环；返回 done 的结果（1 成功，0 失败，-1 未调用）
+    static int runAsync(fsm::StateMachine* m) {
+        fsm::Context ctx;
+        std::deque<std::pair<int, std::function<void()>>> queue;
+        auto scheduler = [&](int delayMs, std::function<void()> task) {
+            queue.emplace_back(delayMs, std::move(task));
+        };
+        int result = -1;
+        QElapsedTimer timer;
+        timer.start();
+        m->start(&ctx, scheduler, [&](bool ok) { result = ok ? 1 : 0; },
+                 [&]() { return timer.elapsed() > 3000; });
+        while (!queue.empty()) {
+            auto job = std::move(queue.front());
+            queue.pop_front();
+            if (job.first > 0) QThread::msleep(job.first);
+            job.second();
+        }
+        return result;
+    }
+
+private slots:
+    void handledTicksTimeOutInRun() {
+        fsm::StateMachine m;
+        Counters n;
+        build(&m, &n);
+        fsm::Context ctx;
+        QElapsedTimer timer;
+        timer.start();
+        // 超时没有生效时靠 shouldStop 在 3 秒后退出，run 返回 false
+        const bool ok = m.run(&ctx, [&]() { return timer.elapsed() > 3000; });
+        QVERIFY(ok);
+        QCOMPARE(n.work, 0);
+        QCOMPARE(n.error, 1);
+        QVERIFY(timer.elapsed() >= 200);
+    }
+
+    void handledTicksTimeOutInStart() {
+        fsm::StateMachine m;
+        Counters n;
+        build(&m, &n);
+        QCOMPARE(runAsync(&m), 1);
+        QCOMPARE(n.work, 0);
+        QCOMPARE(n.error, 1);
+    }
+
+    // 不设超时：监视者连续处理超过 maxRetries 次后状态失败，不会无限循环
+    void handledTicksHitRetryLimitInRun() {
+        fsm::StateMachine m;
+        Counters n;
+        build(&m, &n, 0, 2);
+        fsm::Context ctx;
+        QElapsedTimer timer;
+        timer.start();
+        const bool ok = m.run(&ctx, [&]() { return timer.elapsed() > 3000; });
+        QVERIFY(ok);
+        QCOMPARE(n.work, 0);
+        QCOMPARE(n.handled, 3);
+        QCOMPARE(n.error, 1);
+    }
+
+    void handledTicksHitRetryLimitInStart() {
+        fsm::StateMachine m;
+        Counters n;
+        build(&m, &n, 0, 2);
+        QCOMPARE(runAsync(&m), 1);
+        QCOMPARE(n.work, 0);
+        QCOMPARE(n.handled, 3);
+        QCOMPARE(n.error, 1);
+    }
+};
+
+QTEST_APPLESS_MAIN(TestFsm)
+#include "tst_fsm.moc"
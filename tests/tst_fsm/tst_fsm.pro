@@ -0,0 +1,11 @@
+QT += core testlib
+QT -= gui
+CONFIG += c++2a console testcase
+CONFIG -= app_bundle
+QMAKE_CXXFLAGS += /utf-8
+
+TARGET = tst_fsm
+TEMPLATE = app
+
+INCLUDEPATH += ../..
+SOURCES += tst_fsm.cpp
@@ -0,0 +1,67 @@
+#include <QtTest>
+#include <opencv2/core.hpp>
+#include "templatematcher.h"
+#include "taskmodel.h"
+
+// 多目标匹配的搜索区域：区域外的目标不应被返回
+class TestRoi : public QObject {
+    Q_OBJECT
+
+private:
+    // 随机噪声背景上放两个相同目标：左上 (20,20)，右下 (150,60)
+    static cv::Mat makeScreen(cv::Mat* patch) {
+        cv::RNG rng(7);
+        cv::Mat screen(100, 200, CV_8UC3);
+        rng.fill(screen, cv::RNG::UNIFORM, 0, 256);
+        *patch = cv::Mat(12, 12, CV_8UC3);
+        rng.fill(*patch, cv::RNG::UNIFORM, 0, 256);
+        patch->copyTo(screen(cv::Rect(20, 20, 12, 12)));
+        patch->copyTo(screen(cv::Rect(150, 60, 12, 12)));
+        return screen;
+    }
+
+private slots:
+    void wholeFrameFindsBoth() {
+        cv::Mat patch;
+        vision::Frame frame(makeScreen(&patch));
+        auto tpl = vision::CompiledTemplate::compile("target.png", patch);
+        const auto hits = vision::matchAll(frame, *tpl, 0.95, 16, vision::HitOrder::Position, 0.3,
+                                           vision::searchArea(*tpl));
+        QCOMPARE(int(hits.size()), 2);
+    }
+
+    void callerRoiExcludesOutsideTarget() {
+        cv::Mat patch;
+        vision::Frame frame(makeScreen(&patch));
+        auto tpl = vision::CompiledTemplate::compile("target.png", patch);
+        const auto hits = vision::matchAll(frame, *tpl, 0.95, 16, vision::HitOrder::Position, 0.3,
+                                           vision::searchArea(*tpl, cv::Rect(0, 0, 100, 100)));
+        QCOMPARE(int(hits.size()), 1);
+        QCOMPARE(hits[0].topLeft.x, 20);
+        QCOMPARE(hits[0].topLeft.y, 20);
+    }
+
+    void manifestRoiUsedWhenCallerHasNone() {
+        cv::Mat patch;
+        vision::Frame frame(makeScreen(&patch));
+        vision::TemplateMeta meta;
+        meta.roiHint = cv::Rect(100, 0, 100, 100);
+        auto tpl = vision::CompiledTemplate::compile("target.png", patch, meta);
+        const auto hits = vision::matchAll(frame, *tpl, 0.95, 16, vision::HitOrder::Position, 0.3,
+                                           vision::searchArea(*tpl));
+        QCOMPARE(int(hits.size()), 1);
+        QCOMPARE(hits[0].topLeft.x, 150);
+        QCOMPARE(hits[0].topLeft.y, 60);
+    }
+
+    void stepRoiRoundTrip() {
+        TaskStep step;
+        step.type = StepType::FindAll;
+        step.roi = QRect(10, 20, 300, 40);
+        const TaskStep back = TaskStep::fromJson(step.toJson());
+        QCOMPARE(back.roi, QRect(10, 20, 300, 40));
+    }
+};
+
+QTEST_APPLESS_MAIN(TestRoi)
+#include "tst_roi.moc"
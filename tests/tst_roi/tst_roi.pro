@@ -0,0 +1,23 @@
+QT += core gui testlib
+CONFIG += c++2a console testcase
+CONFIG -= app_bundle
+QMAKE_CXXFLAGS += /utf-8
+
+TARGET = tst_roi
+TEMPLATE = app
+
+INCLUDEPATH += ../..
+SOURCES += \
+    tst_roi.cpp \
+    ../../templatematcher.cpp \
+    ../../templatetuner.cpp \
+    ../../templatepack.cpp \
+    ../../taskmodel.cpp
+
+# -------- OpenCV headers & libs（与 hjdz.pro 相同） --------
+INCLUDEPATH += D:/hjdz/opencv/build/include
+CONFIG(debug, debug|release) {
+    LIBS += -LD:/hjdz/hjdz -lopencv_world4120d
+} else {
+    LIBS += -LD:/hjdz/hjdz -lopencv_world4120
+}